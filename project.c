@@ -1,12 +1,32 @@
 
+#define _GNU_SOURCE // accept4, strsep
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 #include <string.h>
+#include <ctype.h>
+#include <strings.h>
 #include <pthread.h>
-#include <semaphore.h>
 #include <unistd.h>
 #include <time.h>
 #include <signal.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <stdarg.h>
 
 // ANSI color codes for beautification
 #define COLOR_RESET   "\033[0m"
@@ -18,302 +38,6880 @@
 #define COLOR_BOLD    "\033[1m"
 
 // ------------- CONSTANTS & ENUMS ------------
-#define TOTAL_BEDS 5
-#define ICU_BEDS 5
-#define GENERAL_BEDS 10
-#define MAX_PATIENTS 100
+// Ward layout: X(id, name, default beds, expected stay in ms), one line per
+// ward. The WardId enum, ward names, default capacities and stays are
+// generated from this table; capacities, stays and ICU/General routing can
+// be overridden with --wards.
+#define WARD_LAYOUT(X)                             \
+    X(WARD_ADMISSION, "Admission", 5,  20000)      \
+    X(WARD_ICU,       "ICU",       5,  1000)       \
+    X(WARD_GENERAL,   "General",   10, 1000)
+#define WARD_ENUM(id, name, beds, stay) id,
+#define WARD_NAME(id, name, beds, stay) name,
+#define WARD_BEDS(id, name, beds, stay) beds,
+#define WARD_STAY(id, name, beds, stay) stay,
+#define CACHE_LINE 64
+#define POOL_WORKERS 4
+#define SHARD_POOL_WORKERS 2 // Per shard when running several hospitals
+#define WARD_MAX_BEDS 4096 // 64 words of 64 beds under one summary word
+#define WARD_MAX_STAY_SECS (86400 * 14) // Longest expected stay; in ms it still fits an int
+#define PQ_INITIAL_CAPACITY 16 // Per triage level; must be a power of two
+#define POOL_SLAB_PATIENTS 256
+#define JOURNAL_INITIAL_SIZE (1 << 20)
+#define JOURNAL_SNAPSHOT_EVERY 4096 // Appended records between compactions
 
-typedef enum { REGULAR, EMERGENCY, GENERAL, ICU } PatientType;
+typedef enum { REGULAR, EMERGENCY, GENERAL, ICU, PATIENT_TYPE_COUNT } PatientType;
 
 // ------------- PATIENT STRUCT ------------
+// Fields read on the scheduling path (queue aging, admission, bed
+// allocation) come first so they share one cache line; display data trail
+// behind. The name lives in the identity store (see IDENTITY STORE).
+typedef uint32_t IdentityHandle; // 0: anonymous
+
+// Intrusive expected-discharge timer, linked into the shard's timer wheel
+// while the patient holds a bed (see TIMER WHEEL)
+typedef struct WheelTimer {
+    struct WheelTimer* next; // NULL: not scheduled
+    struct WheelTimer* prev;
+    uint64_t due;            // Wheel tick it fires on
+    int ward;                // Bed it was armed for
+    int bed;
+    int slot;                // level * WHEEL_SLOTS + slot
+} WheelTimer;
+
+typedef struct {
+    int id;
+    PatientType type;
+    int severity; // For ICU/general distinction
+    int isICU; // For code that uses ICU flag
+    time_t check_in_time;
+    unsigned long seq; // Arrival order, breaks ties within the same second
+    uint64_t check_in_ns; // Monotonic check-in time, for admission latency
+    int age; // Some code uses age
+    IdentityHandle ident;
+    WheelTimer discharge;
+} Patient;
+
+// ------------- TIMING & LOCK STATS ------------
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// ------------- METRICS -------------
+// Low-overhead counters and HDR-style histograms. Each thread writes only
+// its own shard (plain relaxed load+store, no locked RMW); readers merge
+// all shards. Histogram buckets are log-linear: 16 sub-buckets per power of
+// two, so any recorded value is reported within ~6%.
+#define HIST_SUB_BITS 4
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_MAX_EXP 40 // Values from 2^40 (~18 minutes in ns) up share the last bucket
+#define HIST_BUCKETS ((HIST_MAX_EXP - HIST_SUB_BITS + 1) * HIST_SUB)
+
+typedef enum {
+    MET_ADMISSIONS,
+    MET_DISCHARGES,
+    MET_TRANSFERS,
+    MET_WARD_PARKED,
+    MET_COUNTER_COUNT
+} MetricCounter;
+
+// MET_HIST_NONE is 0 so that zero-initialised lock stats record nothing
+typedef enum {
+    MET_HIST_NONE,
+    MET_BED_LOCK_WAIT,
+    MET_BED_LOCK_HOLD,
+    MET_PQ_LOCK_WAIT,
+    MET_PQ_LOCK_HOLD,
+    MET_LOG_LOCK_WAIT,
+    MET_LOG_LOCK_HOLD,
+    MET_ICU_BED_WAIT,
+    MET_GENERAL_BED_WAIT,
+    MET_ADMIT_LATENCY,
+    MET_QUEUE_DEPTH,
+    MET_HIST_COUNT
+} MetricHist;
+
+static const char* const metric_counter_names[MET_COUNTER_COUNT] = {
+    "hospital_admissions_total",
+    "hospital_discharges_total",
+    "hospital_transfers_total",
+    "hospital_ward_requests_parked_total",
+};
+
+// Histograms named *_seconds hold nanoseconds and are scaled on output
+static const char* const metric_hist_names[MET_HIST_COUNT] = {
+    NULL,
+    "hospital_bed_lock_wait_seconds",
+    "hospital_bed_lock_hold_seconds",
+    "hospital_queue_lock_wait_seconds",
+    "hospital_queue_lock_hold_seconds",
+    "hospital_log_lock_wait_seconds",
+    "hospital_log_lock_hold_seconds",
+    "hospital_icu_bed_wait_seconds",
+    "hospital_general_bed_wait_seconds",
+    "hospital_admission_latency_seconds",
+    "hospital_queue_depth",
+};
+
+typedef struct {
+    atomic_ulong count;
+    atomic_ulong sum;
+    atomic_ulong max;
+    atomic_ulong buckets[HIST_BUCKETS];
+} Histogram;
+
+typedef struct MetricsShard {
+    atomic_ulong counters[MET_COUNTER_COUNT];
+    Histogram hist[MET_HIST_COUNT];
+    struct MetricsShard* next;
+} MetricsShard;
+
+// Merged view of one histogram
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[HIST_BUCKETS];
+} HistSnapshot;
+
+static int metrics_enabled;
+static _Atomic(MetricsShard*) metrics_shards;
+static _Thread_local MetricsShard* metrics_local;
+
+static int hist_bucket(uint64_t v) {
+    if (v < HIST_SUB)
+        return (int)v;
+    int e = 63 - __builtin_clzll(v);
+    if (e >= HIST_MAX_EXP)
+        return HIST_BUCKETS - 1;
+    return (e - HIST_SUB_BITS + 1) * HIST_SUB + (int)((v >> (e - HIST_SUB_BITS)) & (HIST_SUB - 1));
+}
+
+// Midpoint of a bucket's value range
+static uint64_t hist_bucket_value(int b) {
+    if (b < HIST_SUB)
+        return (uint64_t)b;
+    int e = b / HIST_SUB - 1 + HIST_SUB_BITS;
+    uint64_t width = 1ull << (e - HIST_SUB_BITS);
+    return ((uint64_t)(HIST_SUB + b % HIST_SUB) << (e - HIST_SUB_BITS)) + width / 2;
+}
+
+// Shards are never freed while the process runs, so an exited thread's
+// samples still show up in the totals
+static MetricsShard* metrics_shard(void) {
+    MetricsShard* m = metrics_local;
+    if (m)
+        return m;
+    m = calloc(1, sizeof(MetricsShard));
+    if (!m)
+        return NULL;
+    MetricsShard* head = atomic_load(&metrics_shards);
+    do {
+        m->next = head;
+    } while (!atomic_compare_exchange_weak(&metrics_shards, &head, m));
+    return metrics_local = m;
+}
+
+// Only the owning thread writes a shard
+static inline void metric_bump(atomic_ulong* c, uint64_t v) {
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + v, memory_order_relaxed);
+}
+
+static void metric_count(MetricCounter c, uint64_t v) {
+    MetricsShard* m = metrics_enabled ? metrics_shard() : NULL;
+    if (m)
+        metric_bump(&m->counters[c], v);
+}
+
+static void metric_record(MetricHist h, uint64_t v) {
+    MetricsShard* m = (metrics_enabled && h != MET_HIST_NONE) ? metrics_shard() : NULL;
+    if (!m)
+        return;
+    Histogram* hg = &m->hist[h];
+    metric_bump(&hg->buckets[hist_bucket(v)], 1);
+    metric_bump(&hg->count, 1);
+    metric_bump(&hg->sum, v);
+    if (v > atomic_load_explicit(&hg->max, memory_order_relaxed))
+        atomic_store_explicit(&hg->max, v, memory_order_relaxed);
+}
+
+uint64_t metrics_counter(MetricCounter c) {
+    uint64_t total = 0;
+    for (MetricsShard* m = atomic_load(&metrics_shards); m; m = m->next)
+        total += atomic_load_explicit(&m->counters[c], memory_order_relaxed);
+    return total;
+}
+
+void metrics_read_hist(MetricHist h, HistSnapshot* out) {
+    memset(out, 0, sizeof(*out));
+    for (MetricsShard* m = atomic_load(&metrics_shards); m; m = m->next) {
+        Histogram* hg = &m->hist[h];
+        out->count += atomic_load_explicit(&hg->count, memory_order_relaxed);
+        out->sum += atomic_load_explicit(&hg->sum, memory_order_relaxed);
+        uint64_t mx = atomic_load_explicit(&hg->max, memory_order_relaxed);
+        if (mx > out->max)
+            out->max = mx;
+        for (int b = 0; b < HIST_BUCKETS; ++b)
+            out->buckets[b] += atomic_load_explicit(&hg->buckets[b], memory_order_relaxed);
+    }
+}
+
+uint64_t hist_percentile(const HistSnapshot* s, double pct) {
+    uint64_t total = 0;
+    for (int b = 0; b < HIST_BUCKETS; ++b)
+        total += s->buckets[b];
+    if (total == 0)
+        return 0;
+    uint64_t rank = (uint64_t)ceil(pct / 100.0 * (double)total);
+    if (rank == 0)
+        rank = 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < HIST_BUCKETS; ++b) {
+        seen += s->buckets[b];
+        if (seen >= rank) {
+            uint64_t v = hist_bucket_value(b);
+            return v < s->max ? v : s->max;
+        }
+    }
+    return s->max;
+}
+
+// Single-writer counterpart of metric_record for a private snapshot
+static void hist_add(HistSnapshot* s, uint64_t v) {
+    s->buckets[hist_bucket(v)]++;
+    s->count++;
+    s->sum += v;
+    if (v > s->max)
+        s->max = v;
+}
+
+void hist_merge(HistSnapshot* into, const HistSnapshot* from) {
+    into->count += from->count;
+    into->sum += from->sum;
+    if (from->max > into->max)
+        into->max = from->max;
+    for (int b = 0; b < HIST_BUCKETS; ++b)
+        into->buckets[b] += from->buckets[b];
+}
+
+void metrics_destroy(void) {
+    MetricsShard* m = atomic_exchange(&metrics_shards, NULL);
+    while (m) {
+        MetricsShard* next = m->next;
+        free(m);
+        m = next;
+    }
+    metrics_local = NULL;
+}
+
+// Wait-time accounting for hot mutexes. The uncontended path is a single
+// trylock; only a failed trylock pays for the clock reads. With metrics
+// enabled, wait and hold times also land in the lock's histograms.
+typedef struct {
+    atomic_ulong acquisitions;
+    atomic_ulong contended;
+    atomic_ulong wait_ns;
+    MetricHist wait_metric;
+    MetricHist hold_metric;
+    uint64_t held_since; // Written only by the current holder
+} LockStats;
+
+void lock_stats_init(LockStats* st, MetricHist wait_metric, MetricHist hold_metric) {
+    memset(st, 0, sizeof(*st));
+    st->wait_metric = wait_metric;
+    st->hold_metric = hold_metric;
+}
+
+// Call once the lock is held again (e.g. after pthread_cond_wait)
+static inline void lock_stats_acquired(LockStats* st) {
+    if (metrics_enabled && st->hold_metric != MET_HIST_NONE)
+        st->held_since = now_ns();
+}
+
+// Call just before the lock is given up (unlock or pthread_cond_wait)
+static inline void lock_stats_release(LockStats* st) {
+    if (metrics_enabled && st->hold_metric != MET_HIST_NONE && st->held_since) {
+        metric_record(st->hold_metric, now_ns() - st->held_since);
+        st->held_since = 0;
+    }
+}
+
+static void lock_timed(pthread_mutex_t* m, LockStats* st) {
+    uint64_t waited = 0;
+    if (pthread_mutex_trylock(m) != 0) {
+        uint64_t t0 = now_ns();
+        pthread_mutex_lock(m);
+        waited = now_ns() - t0;
+        atomic_fetch_add_explicit(&st->wait_ns, waited, memory_order_relaxed);
+        atomic_fetch_add_explicit(&st->contended, 1, memory_order_relaxed);
+    }
+    atomic_fetch_add_explicit(&st->acquisitions, 1, memory_order_relaxed);
+    if (metrics_enabled)
+        metric_record(st->wait_metric, waited);
+    lock_stats_acquired(st);
+}
+
+static void unlock_timed(pthread_mutex_t* m, LockStats* st) {
+    lock_stats_release(st);
+    pthread_mutex_unlock(m);
+}
+
+// ------------- PATIENT POOL ------------
+// Patient records are carved out of slabs and recycled through a free list,
+// so check-ins and admissions do not hit malloc/free once the pool is warm
+typedef union PoolSlot {
+    Patient patient;
+    union PoolSlot* next_free;
+} PoolSlot;
+
+typedef struct PoolSlab {
+    struct PoolSlab* next;
+    PoolSlot slots[POOL_SLAB_PATIENTS];
+} PoolSlab;
+
+typedef struct {
+    PoolSlab* slabs;
+    PoolSlot* free_list;
+    size_t in_use;
+    pthread_mutex_t lock;
+} PatientPool;
+
+static PatientPool patient_pool;
+
+void patient_pool_init(PatientPool* pool) {
+    pool->slabs = NULL;
+    pool->free_list = NULL;
+    pool->in_use = 0;
+    pthread_mutex_init(&pool->lock, NULL);
+}
+
+// Caller holds pool->lock
+static int patient_pool_grow(PatientPool* pool) {
+    PoolSlab* slab = malloc(sizeof(PoolSlab));
+    if (!slab)
+        return -1;
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+    for (int i = POOL_SLAB_PATIENTS - 1; i >= 0; --i) {
+        slab->slots[i].next_free = pool->free_list;
+        pool->free_list = &slab->slots[i];
+    }
+    return 0;
+}
+
+Patient* patient_alloc_from(PatientPool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    if (!pool->free_list && patient_pool_grow(pool) < 0) {
+        pthread_mutex_unlock(&pool->lock);
+        return NULL;
+    }
+    PoolSlot* slot = pool->free_list;
+    pool->free_list = slot->next_free;
+    pool->in_use++;
+    pthread_mutex_unlock(&pool->lock);
+    memset(&slot->patient, 0, sizeof(Patient));
+    return &slot->patient;
+}
+
+void patient_free_to(PatientPool* pool, Patient* p) {
+    if (!p)
+        return;
+    PoolSlot* slot = (PoolSlot*)p;
+    pthread_mutex_lock(&pool->lock);
+    slot->next_free = pool->free_list;
+    pool->free_list = slot;
+    pool->in_use--;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+Patient* patient_alloc(void) {
+    return patient_alloc_from(&patient_pool);
+}
+
+void patient_free(Patient* p) {
+    patient_free_to(&patient_pool, p);
+}
+
+void patient_pool_destroy(PatientPool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->slabs) {
+        PoolSlab* next = pool->slabs->next;
+        free(pool->slabs);
+        pool->slabs = next;
+    }
+    pool->free_list = NULL;
+    pool->in_use = 0;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// ------------- IDENTITY STORE -------------
+// Process-wide table of patient identities: an interned name plus an
+// optional medical record number (MRN). Patients, log records and the
+// occupant index carry a 32-bit IdentityHandle instead of a name buffer.
+// Repeat visitors resolve to the same identity, and identities that share
+// a name share one copy of the string. Entries live in fixed chunks and
+// names in an append-only arena, so nothing moves once published and
+// identity_name() is lock-free. Interning and lookup by name or MRN take
+// the store lock.
+#define IDENT_CHUNK_BITS 12
+#define IDENT_CHUNK (1u << IDENT_CHUNK_BITS)
+#define IDENT_MAX_CHUNKS 4096 // 16M identities
+#define IDENT_NAME_MAX 64     // Including the terminator, as on disk
+#define IDENT_ARENA_BLOCK (64 * 1024)
+
+typedef struct {
+    const char* name; // Interned; never freed while the store is open
+    uint64_t mrn;     // 0: none
+    uint32_t name_hash;
+    atomic_int last_patient; // Id of the most recent visit
+    atomic_uint visits;
+} Identity;
+
+typedef struct IdentityArena {
+    struct IdentityArena* next;
+    size_t used;
+    char data[IDENT_ARENA_BLOCK];
+} IdentityArena;
+
+typedef struct {
+    _Atomic(Identity*) chunks[IDENT_MAX_CHUNKS];
+    atomic_uint count;     // Handles 1..count are valid
+    pthread_mutex_t lock;
+    uint32_t* by_name;     // Open-addressed handles keyed on name (latest with that name)
+    uint32_t* by_mrn;      // Keyed on MRN
+    size_t table_cap;      // Power of two, shared by both tables
+    IdentityArena* arena;
+} IdentityStore;
+
+static IdentityStore identities = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static uint32_t ident_hash_name(const char* s) {
+    uint32_t h = 2166136261u; // FNV-1a
+    while (*s)
+        h = (h ^ (unsigned char)*s++) * 16777619u;
+    return h;
+}
+
+static size_t ident_hash_mrn(uint64_t mrn, size_t mask) {
+    return (size_t)((mrn * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+}
+
+static Identity* ident_entry(uint32_t handle) {
+    Identity* chunk = atomic_load_explicit(&identities.chunks[(handle - 1) >> IDENT_CHUNK_BITS], memory_order_acquire);
+    return &chunk[(handle - 1) & (IDENT_CHUNK - 1)];
+}
+
+// Name for a handle; "" for handle 0. Safe without the lock for any handle
+// obtained from a Patient or a lookup.
+const char* identity_name(IdentityHandle handle) {
+    return handle ? ident_entry(handle)->name : "";
+}
+
+Identity* identity_get(IdentityHandle handle) {
+    return (handle && handle <= atomic_load(&identities.count)) ? ident_entry(handle) : NULL;
+}
+
+// Caller holds the lock; returns the slot holding name, or the empty slot for it
+static uint32_t* ident_probe_name(const char* name, uint32_t hash) {
+    size_t mask = identities.table_cap - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        uint32_t hd = identities.by_name[i];
+        if (!hd)
+            return &identities.by_name[i];
+        Identity* e = ident_entry(hd);
+        if (e->name_hash == hash && strcmp(e->name, name) == 0)
+            return &identities.by_name[i];
+    }
+}
+
+// Caller holds the lock
+static uint32_t* ident_probe_mrn(uint64_t mrn) {
+    size_t mask = identities.table_cap - 1;
+    for (size_t i = ident_hash_mrn(mrn, mask);; i = (i + 1) & mask) {
+        uint32_t hd = identities.by_mrn[i];
+        if (!hd || ident_entry(hd)->mrn == mrn)
+            return &identities.by_mrn[i];
+    }
+}
+
+// Caller holds the lock; keeps both tables under half full
+static int ident_grow_tables(void) {
+    size_t cap = identities.table_cap ? identities.table_cap * 2 : 1024;
+    uint32_t* by_name = calloc(cap, sizeof(uint32_t));
+    uint32_t* by_mrn = calloc(cap, sizeof(uint32_t));
+    if (!by_name || !by_mrn) {
+        free(by_name);
+        free(by_mrn);
+        return -1;
+    }
+    uint32_t* old_name = identities.by_name;
+    uint32_t* old_mrn = identities.by_mrn;
+    size_t old_cap = identities.table_cap;
+    identities.by_name = by_name;
+    identities.by_mrn = by_mrn;
+    identities.table_cap = cap;
+    for (size_t i = 0; i < old_cap; ++i) {
+        if (old_name[i]) {
+            Identity* e = ident_entry(old_name[i]);
+            *ident_probe_name(e->name, e->name_hash) = old_name[i];
+        }
+        if (old_mrn[i])
+            *ident_probe_mrn(ident_entry(old_mrn[i])->mrn) = old_mrn[i];
+    }
+    free(old_name);
+    free(old_mrn);
+    return 0;
+}
+
+// Caller holds the lock
+static const char* ident_arena_copy(const char* name, size_t len) {
+    IdentityArena* a = identities.arena;
+    if (!a || a->used + len + 1 > sizeof(a->data)) {
+        a = malloc(sizeof(IdentityArena));
+        if (!a)
+            return NULL;
+        a->next = identities.arena;
+        a->used = 0;
+        identities.arena = a;
+    }
+    char* s = a->data + a->used;
+    memcpy(s, name, len);
+    s[len] = '\0';
+    a->used += len + 1;
+    return s;
+}
+
+// Identity for (name, mrn), created on first sight. With an MRN the record
+// number decides; without one, the latest identity with that name is
+// reused. Returns 0 if the store is out of memory or full.
+IdentityHandle identity_intern(const char* name, uint64_t mrn) {
+    char buf[IDENT_NAME_MAX];
+    size_t len = strnlen(name, IDENT_NAME_MAX - 1);
+    memcpy(buf, name, len);
+    buf[len] = '\0';
+    uint32_t hash = ident_hash_name(buf);
+    pthread_mutex_lock(&identities.lock);
+    uint32_t count = atomic_load_explicit(&identities.count, memory_order_relaxed);
+    if ((size_t)(count + 1) * 2 > identities.table_cap && ident_grow_tables() < 0) {
+        pthread_mutex_unlock(&identities.lock);
+        return 0;
+    }
+    uint32_t* mrn_slot = mrn ? ident_probe_mrn(mrn) : NULL;
+    uint32_t* name_slot = ident_probe_name(buf, hash);
+    IdentityHandle found = mrn ? *mrn_slot : *name_slot;
+    if (found || count >= IDENT_MAX_CHUNKS * IDENT_CHUNK) {
+        pthread_mutex_unlock(&identities.lock);
+        return found;
+    }
+    uint32_t handle = count + 1;
+    uint32_t chunk = count >> IDENT_CHUNK_BITS;
+    if (!atomic_load_explicit(&identities.chunks[chunk], memory_order_relaxed)) {
+        Identity* c = calloc(IDENT_CHUNK, sizeof(Identity));
+        if (!c) {
+            pthread_mutex_unlock(&identities.lock);
+            return 0;
+        }
+        atomic_store_explicit(&identities.chunks[chunk], c, memory_order_release);
+    }
+    const char* interned = *name_slot ? ident_entry(*name_slot)->name : ident_arena_copy(buf, len);
+    if (!interned) {
+        pthread_mutex_unlock(&identities.lock);
+        return 0;
+    }
+    Identity* e = ident_entry(handle);
+    e->name = interned;
+    e->mrn = mrn;
+    e->name_hash = hash;
+    atomic_init(&e->last_patient, 0);
+    atomic_init(&e->visits, 0);
+    *name_slot = handle;
+    if (mrn_slot)
+        *mrn_slot = handle;
+    atomic_store_explicit(&identities.count, handle, memory_order_release);
+    pthread_mutex_unlock(&identities.lock);
+    return handle;
+}
+
+// Latest identity with this exact name, or 0
+IdentityHandle identity_find_name(const char* name) {
+    uint32_t hash = ident_hash_name(name);
+    pthread_mutex_lock(&identities.lock);
+    IdentityHandle h = identities.table_cap ? *ident_probe_name(name, hash) : 0;
+    pthread_mutex_unlock(&identities.lock);
+    return h;
+}
+
+IdentityHandle identity_find_mrn(uint64_t mrn) {
+    pthread_mutex_lock(&identities.lock);
+    IdentityHandle h = (mrn && identities.table_cap) ? *ident_probe_mrn(mrn) : 0;
+    pthread_mutex_unlock(&identities.lock);
+    return h;
+}
+
+// Record a check-in against p's identity
+static void identity_visit(const Patient* p) {
+    Identity* e = identity_get(p->ident);
+    if (!e)
+        return;
+    atomic_store_explicit(&e->last_patient, p->id, memory_order_relaxed);
+    atomic_fetch_add_explicit(&e->visits, 1, memory_order_relaxed);
+}
+
+// Call once nothing can resolve a handle any more
+void identity_store_destroy(void) {
+    pthread_mutex_lock(&identities.lock);
+    for (int c = 0; c < IDENT_MAX_CHUNKS; ++c) {
+        free(atomic_load(&identities.chunks[c]));
+        atomic_store(&identities.chunks[c], NULL);
+    }
+    while (identities.arena) {
+        IdentityArena* next = identities.arena->next;
+        free(identities.arena);
+        identities.arena = next;
+    }
+    free(identities.by_name);
+    free(identities.by_mrn);
+    identities.by_name = identities.by_mrn = NULL;
+    identities.table_cap = 0;
+    atomic_store(&identities.count, 0);
+    pthread_mutex_unlock(&identities.lock);
+}
+
+// ------------- PRIORITY QUEUE -----------
+// Multi-level triage queue: one FIFO bucket per (type, severity), with a
+// bitmap of non-empty levels so push is O(1) and pop is a find-last-set.
+// Type dominates (ICU > GENERAL > EMERGENCY > REGULAR), then severity, then
+// arrival order. REGULAR patients who have waited aging_secs are promoted
+// one level per interval, up to aging_max_level.
+// Check-ins go through a bounded lock-free arrival ring (pq_submit), so
+// producers never wait on pq->lock; whoever next takes the lock to read the
+// queue (in practice the shard's admission thread) drains the ring into
+// the buckets first. A full ring makes the producer drain it under the lock
+// and push through, so a burst degrades to a locked push instead of failing.
+#define PQ_SEVERITY_LEVELS 10
+#define PQ_LEVELS (4 * PQ_SEVERITY_LEVELS)
+#define PQ_LEVEL(type, severity) ((type) * PQ_SEVERITY_LEVELS + (severity) - 1)
+#define PQ_DEFAULT_AGING_SECS 30
+#define PQ_ARRIVAL_SLOTS 4096 // Power of two
+
+typedef struct {
+    atomic_size_t seq;
+    Patient* patient;
+} PQArrivalSlot;
+
+typedef struct {
+    Patient** items; // Ring buffer, doubles on demand
+    int head;
+    int count;
+    int capacity;
+} PQLevel;
+
+typedef struct {
+    PQLevel levels[PQ_LEVELS];
+    uint64_t nonempty; // Bit l set: levels[l].count > 0
+    atomic_int size;   // Bucketed patients; written under lock, read without it
+    unsigned long next_seq;
+    int aging_secs;      // 0 disables aging
+    int aging_max_level;
+    time_t last_aged;
+    pthread_mutex_t lock;
+    LockStats push_stats;
+    LockStats pop_stats;
+    PQArrivalSlot* arrivals;             // NULL: check-ins push under the lock
+    _Alignas(CACHE_LINE) atomic_size_t arrive_pos; // Next slot a producer claims
+    _Alignas(CACHE_LINE) atomic_size_t drain_pos;  // Next slot to drain; advanced under lock
+} PriorityQueue;
+
+static int pq_level_of(const Patient* p) {
+    int sev = p->severity;
+    if (sev < 1)
+        sev = 1;
+    else if (sev > PQ_SEVERITY_LEVELS)
+        sev = PQ_SEVERITY_LEVELS;
+    return PQ_LEVEL(p->type, sev);
+}
+
+void pq_init(PriorityQueue* pq) {
+    memset(pq->levels, 0, sizeof(pq->levels));
+    pq->nonempty = 0;
+    pq->size = 0;
+    pq->next_seq = 0;
+    pq->aging_secs = PQ_DEFAULT_AGING_SECS;
+    pq->aging_max_level = PQ_LEVEL(EMERGENCY, 1);
+    pq->last_aged = 0;
+    lock_stats_init(&pq->push_stats, MET_PQ_LOCK_WAIT, MET_PQ_LOCK_HOLD);
+    lock_stats_init(&pq->pop_stats, MET_PQ_LOCK_WAIT, MET_PQ_LOCK_HOLD);
+    pthread_mutex_init(&pq->lock, NULL);   
+    pq->arrivals = malloc(sizeof(PQArrivalSlot) * PQ_ARRIVAL_SLOTS);
+    for (size_t i = 0; pq->arrivals && i < PQ_ARRIVAL_SLOTS; ++i)
+        atomic_init(&pq->arrivals[i].seq, i);
+    atomic_init(&pq->arrive_pos, 0);
+    atomic_init(&pq->drain_pos, 0);
+}
+
+void pq_set_aging(PriorityQueue* pq, int aging_secs, int max_level) {
+    pthread_mutex_lock(&pq->lock);
+    pq->aging_secs = aging_secs;
+    pq->aging_max_level = (max_level >= PQ_LEVELS) ? PQ_LEVELS - 1 : max_level;
+    pthread_mutex_unlock(&pq->lock);
+}
+
+static void pq_drain_locked(PriorityQueue* pq);
+
+// Patients still queued are not freed; their owner does that
+void pq_destroy(PriorityQueue* pq) {
+    pthread_mutex_lock(&pq->lock);
+    pq_drain_locked(pq);
+    free(pq->arrivals);
+    pq->arrivals = NULL;
+    for (int l = 0; l < PQ_LEVELS; ++l) {
+        free(pq->levels[l].items);
+        pq->levels[l].items = NULL;
+        pq->levels[l].count = pq->levels[l].capacity = 0;
+    }
+    pq->nonempty = 0;
+    pq->size = 0;
+    pthread_mutex_unlock(&pq->lock);
+}
+
+// i-th patient of a level in FIFO order; caller holds pq->lock
+static Patient* pq_level_at(const PQLevel* lv, int i) {
+    return lv->items[(lv->head + i) & (lv->capacity - 1)];
+}
+
+// Caller holds pq->lock
+static int pq_level_append(PriorityQueue* pq, int level, Patient* p) {
+    PQLevel* lv = &pq->levels[level];
+    if (lv->count == lv->capacity) {
+        int cap = lv->capacity ? lv->capacity * 2 : PQ_INITIAL_CAPACITY;
+        Patient** grown = malloc(sizeof(Patient*) * cap);
+        if (!grown)
+            return -1;
+        for (int i = 0; i < lv->count; ++i)
+            grown[i] = pq_level_at(lv, i);
+        free(lv->items);
+        lv->items = grown;
+        lv->head = 0;
+        lv->capacity = cap;
+    }
+    lv->items[(lv->head + lv->count) & (lv->capacity - 1)] = p;
+    lv->count++;
+    pq->nonempty |= 1ULL << level;
+    return 0;
+}
+
+// Caller holds pq->lock; level must be non-empty
+static Patient* pq_level_take(PriorityQueue* pq, int level) {
+    PQLevel* lv = &pq->levels[level];
+    Patient* p = lv->items[lv->head];
+    lv->head = (lv->head + 1) & (lv->capacity - 1);
+    if (--lv->count == 0)
+        pq->nonempty &= ~(1ULL << level);
+    return p;
+}
+
+// Move every published arrival into its bucket, in arrival order. Stops at
+// a patient whose bucket cannot grow, leaving it in the ring for next time.
+// Caller holds pq->lock, which serialises the ring's consumers.
+static void pq_drain_locked(PriorityQueue* pq) {
+    if (!pq->arrivals)
+        return;
+    size_t pos = atomic_load_explicit(&pq->drain_pos, memory_order_relaxed);
+    int drained = 0;
+    for (;;) {
+        PQArrivalSlot* slot = &pq->arrivals[pos & (PQ_ARRIVAL_SLOTS - 1)];
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != pos + 1)
+            break;
+        Patient* p = slot->patient;
+        p->seq = pq->next_seq;
+        if (pq_level_append(pq, pq_level_of(p), p) < 0)
+            break;
+        pq->next_seq++;
+        atomic_store_explicit(&slot->seq, pos + PQ_ARRIVAL_SLOTS, memory_order_release);
+        pos++;
+        drained++;
+    }
+    if (drained) {
+        atomic_fetch_add_explicit(&pq->size, drained, memory_order_relaxed);
+        atomic_store_explicit(&pq->drain_pos, pos, memory_order_release); // After size, see pq_size
+    }
+}
+
+// Lock-free; returns -1 when the ring is full (or was never allocated)
+static int pq_arrival_push(PriorityQueue* pq, Patient* p) {
+    if (!pq->arrivals)
+        return -1;
+    size_t pos = atomic_load_explicit(&pq->arrive_pos, memory_order_relaxed);
+    for (;;) {
+        PQArrivalSlot* slot = &pq->arrivals[pos & (PQ_ARRIVAL_SLOTS - 1)];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&pq->arrive_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                slot->patient = p;
+                atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+                return 0;
+            }
+        } else if (diff < 0) {
+            return -1; // Full
+        } else {
+            pos = atomic_load_explicit(&pq->arrive_pos, memory_order_relaxed);
+        }
+    }
+}
+
+// Promote long-waiting REGULAR patients. Buckets are FIFO, so checking the
+// heads is enough: a promoted patient that lands behind a younger head is
+// picked up on a later pass once that head has moved on.
+// Caller holds pq->lock
+static void pq_age(PriorityQueue* pq, time_t now) {
+    if (pq->aging_secs <= 0 || now == pq->last_aged)
+        return;
+    pq->last_aged = now;
+    for (int l = PQ_LEVEL(REGULAR, PQ_SEVERITY_LEVELS); l >= PQ_LEVEL(REGULAR, 1); --l) {
+        while (pq->nonempty & (1ULL << l)) {
+            Patient* p = pq_level_at(&pq->levels[l], 0);
+            int target = pq_level_of(p) + (int)((now - p->check_in_time) / pq->aging_secs);
+            if (target > pq->aging_max_level)
+                target = pq->aging_max_level;
+            if (target <= l)
+                break;
+            pq_level_take(pq, l);
+            if (pq_level_append(pq, target, p) < 0) {
+                pq_level_append(pq, l, p); // Cannot grow target; keep it where it was
+                break;
+            }
+        }
+    }
+}
+
+// Returns 0 on success, -1 if the bucket could not grow
+int pq_push(PriorityQueue* pq, Patient* patient) {
+    lock_timed(&pq->lock, &pq->push_stats);
+    pq_drain_locked(pq); // Keeps arrival order with anything already submitted
+    patient->seq = pq->next_seq;
+    if (pq_level_append(pq, pq_level_of(patient), patient) < 0) {
+        unlock_timed(&pq->lock, &pq->push_stats);
+        return -1;
+    }
+    pq->next_seq++;
+    pq->size++;
+    unlock_timed(&pq->lock, &pq->push_stats);
+    return 0;
+}
+
+// 'now' drives aging; the simulator passes its virtual clock here
+Patient* pq_pop_at(PriorityQueue* pq, time_t now) {
+    lock_timed(&pq->lock, &pq->pop_stats);
+    pq_drain_locked(pq);
+    if (pq->size == 0) {
+        unlock_timed(&pq->lock, &pq->pop_stats);
+        return NULL;
+    }
+    pq_age(pq, now);
+    Patient* top = pq_level_take(pq, 63 - __builtin_clzll(pq->nonempty));
+    pq->size--;
+    unlock_timed(&pq->lock, &pq->pop_stats);
+    return top;
+}
+
+Patient* pq_pop(PriorityQueue* pq) {
+    return pq_pop_at(pq, time(NULL));
+}
+
+// Pop up to max patients in priority order under one lock acquisition,
+// aging once for the whole batch. Returns how many were popped.
+int pq_pop_batch_at(PriorityQueue* pq, Patient** out, int max, time_t now) {
+    lock_timed(&pq->lock, &pq->pop_stats);
+    pq_drain_locked(pq);
+    int n = 0;
+    if (pq->size > 0) {
+        pq_age(pq, now);
+        while (n < max && pq->nonempty)
+            out[n++] = pq_level_take(pq, 63 - __builtin_clzll(pq->nonempty));
+        pq->size -= n;
+    }
+    unlock_timed(&pq->lock, &pq->pop_stats);
+    return n;
+}
+
+// Pop the head only if it sits at min_level or above; NULL otherwise
+Patient* pq_pop_min_level(PriorityQueue* pq, int min_level, time_t now) {
+    lock_timed(&pq->lock, &pq->pop_stats);
+    pq_drain_locked(pq);
+    Patient* top = NULL;
+    if (pq->size > 0) {
+        pq_age(pq, now);
+        int l = 63 - __builtin_clzll(pq->nonempty);
+        if (l >= min_level) {
+            top = pq_level_take(pq, l);
+            pq->size--;
+        }
+    }
+    unlock_timed(&pq->lock, &pq->pop_stats);
+    return top;
+}
+
+// Level of the current head, or -1 when empty
+int pq_top_level(PriorityQueue* pq) {
+    pthread_mutex_lock(&pq->lock);
+    pq_drain_locked(pq);
+    int l = pq->size ? 63 - __builtin_clzll(pq->nonempty) : -1;
+    pthread_mutex_unlock(&pq->lock);
+    return l;
+}
+
+// Append a batch under one lock acquisition. Buckets are FIFO, so there is
+// nothing to heapify; patients keep their order within each level.
+// Returns how many were queued (all of them unless a bucket could not grow).
+int pq_push_batch(PriorityQueue* pq, Patient* const* patients, int n) {
+    lock_timed(&pq->lock, &pq->push_stats);
+    pq_drain_locked(pq);
+    int pushed = 0;
+    for (; pushed < n; ++pushed) {
+        Patient* p = patients[pushed];
+        p->seq = pq->next_seq;
+        if (pq_level_append(pq, pq_level_of(p), p) < 0)
+            break;
+        pq->next_seq++;
+    }
+    pq->size += pushed;
+    unlock_timed(&pq->lock, &pq->push_stats);
+    return pushed;
+}
+
+// Check in without touching pq->lock unless the arrival ring is full.
+// Returns 0 on success, -1 if the patient could not be queued.
+int pq_submit(PriorityQueue* pq, Patient* patient) {
+    if (pq_arrival_push(pq, patient) == 0)
+        return 0;
+    return pq_push(pq, patient);
+}
+
+// Batch form; once the ring fills, the rest go in with one pq_push_batch.
+// Returns how many were queued (a prefix).
+int pq_submit_batch(PriorityQueue* pq, Patient* const* patients, int n) {
+    int i = 0;
+    while (i < n && pq_arrival_push(pq, patients[i]) == 0)
+        i++;
+    return i < n ? i + pq_push_batch(pq, patients + i, n - i) : n;
+}
+
+// Lock-free: bucketed patients plus arrivals not yet drained. Reading
+// drain_pos first means a concurrent drain can only be counted twice, never
+// missed, so a non-empty queue never reads as empty.
+int pq_size(PriorityQueue* pq) {
+    size_t drained = atomic_load_explicit(&pq->drain_pos, memory_order_acquire);
+    int size = atomic_load_explicit(&pq->size, memory_order_relaxed);
+    size_t arrived = atomic_load_explicit(&pq->arrive_pos, memory_order_relaxed);
+    return size + (arrived > drained ? (int)(arrived - drained) : 0);
+}
+
+int pq_is_empty(PriorityQueue* pq) {
+    return pq_size(pq) == 0;
+}
+
+// Id of the patient next in line (0 when empty), with its level in *level (-1)
+int pq_peek_head(PriorityQueue* pq, int* level) {
+    pthread_mutex_lock(&pq->lock);
+    pq_drain_locked(pq);
+    int l = pq->size ? 63 - __builtin_clzll(pq->nonempty) : -1;
+    int id = l >= 0 ? pq->levels[l].items[pq->levels[l].head]->id : 0;
+    pthread_mutex_unlock(&pq->lock);
+    *level = l;
+    return id;
+}
+// ------------- CPU AFFINITY -------------
+// Threads come in roles, and --cpus ROLE=LIST gives a role its CPUs. A
+// shard role (admit, discharge, workers) puts shard k's threads on the
+// k-th CPU of its list, wrapping around; without a list they use the
+// shard's default core (see --no-pin). A process-wide role (status, net,
+// logger, console) may run on any CPU in its list and floats without one.
+// Each shard's queue, wards, index and wheel are first touched by a thread
+// already on its admission CPU, so the kernel's first-touch policy places
+// them on that CPU's NUMA node (see hospital_init_local).
+typedef enum {
+    ROLE_ADMIT, ROLE_DISCHARGE, ROLE_WORKERS, // Per shard
+    ROLE_STATUS, ROLE_NET, ROLE_LOGGER, ROLE_CONSOLE,
+    ROLE_COUNT
+} ThreadRole;
+#define ROLE_SHARD_COUNT 3
+
+static const char* const thread_role_names[ROLE_COUNT] = {
+    "admit", "discharge", "workers", "status", "net", "logger", "console"
+};
+static cpu_set_t role_cpus[ROLE_COUNT];
+static int role_ncpus[ROLE_COUNT]; // 0: role not configured
+
+// Parse "0-3,8" into set; returns the number of CPUs, or -1
+static int affinity_parse_list(const char* list, cpu_set_t* set) {
+    CPU_ZERO(set);
+    const char* s = list;
+    while (*s) {
+        char* end;
+        long lo = strtol(s, &end, 10), hi = lo;
+        if (end == s)
+            return -1;
+        if (*end == '-') {
+            s = end + 1;
+            hi = strtol(s, &end, 10);
+            if (end == s)
+                return -1;
+        }
+        if (lo < 0 || hi < lo || hi >= CPU_SETSIZE)
+            return -1;
+        for (long c = lo; c <= hi; ++c)
+            CPU_SET((int)c, set);
+        if (*end != ',' && *end != '\0')
+            return -1;
+        s = *end ? end + 1 : end;
+    }
+    return CPU_COUNT(set) ? CPU_COUNT(set) : -1;
+}
+
+// Apply one --cpus ROLE=LIST; "shard" sets all three shard roles
+int affinity_configure(const char* spec) {
+    const char* eq = strchr(spec, '=');
+    cpu_set_t set;
+    int n = eq ? affinity_parse_list(eq + 1, &set) : -1;
+    size_t len = eq ? (size_t)(eq - spec) : 0;
+    int matched = 0;
+    for (int r = 0; r < ROLE_COUNT && n > 0; ++r) {
+        int shard_alias = len == 5 && strncasecmp(spec, "shard", 5) == 0 && r < ROLE_SHARD_COUNT;
+        if (shard_alias || (strlen(thread_role_names[r]) == len && strncasecmp(spec, thread_role_names[r], len) == 0)) {
+            role_cpus[r] = set;
+            role_ncpus[r] = n;
+            matched = 1;
+        }
+    }
+    if (!matched) {
+        fprintf(stderr, "[ERROR] --cpus expects ROLE=LIST with ROLE one of shard, admit, discharge, workers, status, net, logger, console and LIST like 0-3,8\n");
+        return -1;
+    }
+    return 0;
+}
+
+// CPU for shard k's role-r threads, or fallback when the role has no list
+static int affinity_shard_cpu(ThreadRole r, int k, int fallback) {
+    if (!role_ncpus[r])
+        return fallback;
+    int skip = k % role_ncpus[r];
+    for (int c = 0; c < CPU_SETSIZE; ++c)
+        if (CPU_ISSET(c, &role_cpus[r]) && skip-- == 0)
+            return c;
+    return fallback;
+}
+
+// A failure only costs locality
+static void affinity_apply(pthread_t t, const cpu_set_t* set, const char* what) {
+    int rc = pthread_setaffinity_np(t, sizeof(*set), set);
+    if (rc != 0)
+        fprintf(stderr, "[WARN] Could not pin %s thread: %s\n", what, strerror(rc));
+}
+
+// Pin a process-wide thread to its role's CPUs, if any
+void affinity_pin_role(pthread_t t, ThreadRole r) {
+    if (r >= ROLE_SHARD_COUNT && role_ncpus[r])
+        affinity_apply(t, &role_cpus[r], thread_role_names[r]);
+}
+
+static void affinity_pin_cpu(pthread_t t, int cpu, const char* what) {
+    if (cpu < 0)
+        return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    affinity_apply(t, &set, what);
+}
+
+// NUMA node of a CPU from sysfs, or -1 if unknown
+int cpu_numa_node(int cpu) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR* d = opendir(path);
+    if (!d)
+        return -1;
+    int node = -1;
+    struct dirent* de;
+    while (node < 0 && (de = readdir(d)))
+        if (strncmp(de->d_name, "node", 4) == 0 && isdigit((unsigned char)de->d_name[4]))
+            node = atoi(de->d_name + 4);
+    closedir(d);
+    return node;
+}
+
+// ------------- WORKER POOL -------------
+// Fixed set of worker threads fed from a FIFO of tasks. A task that cannot
+// make progress (e.g. no free bed) is parked by its owner and resubmitted
+// later, so waiting does not pin an OS thread. Delayed tasks sit on a list
+// sorted by deadline and are promoted to the FIFO when due.
+typedef struct Task Task;
+typedef struct WorkerPool WorkerPool;
+typedef void (*TaskFn)(Task* t);
+
+struct Task {
+    TaskFn fn;
+    WorkerPool* pool;
+    struct timespec due;
+    Task* next;
+};
+
+struct WorkerPool {
+    pthread_t* threads;
+    int nthreads;
+    Task* head;
+    Task* tail;
+    Task* delayed;     // Sorted by due time
+    int pending_jobs;  // Jobs begun and not yet finished
+    int stopping;
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t idle;
+};
+
+static int timespec_before(const struct timespec* a, const struct timespec* b) {
+    return a->tv_sec < b->tv_sec || (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+static void* pool_worker(void* arg) {
+    WorkerPool* pool = (WorkerPool*)arg;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        while (pool->delayed && !timespec_before(&now, &pool->delayed->due)) {
+            Task* t = pool->delayed;
+            pool->delayed = t->next;
+            t->next = NULL;
+            if (pool->tail)
+                pool->tail->next = t;
+            else
+                pool->head = t;
+            pool->tail = t;
+        }
+        if (pool->head) {
+            Task* t = pool->head;
+            pool->head = t->next;
+            if (!pool->head)
+                pool->tail = NULL;
+            pthread_mutex_unlock(&pool->lock);
+            t->fn(t);
+            pthread_mutex_lock(&pool->lock);
+            continue;
+        }
+        if (pool->stopping)
+            break;
+        if (pool->delayed)
+            pthread_cond_timedwait(&pool->work, &pool->lock, &pool->delayed->due);
+        else
+            pthread_cond_wait(&pool->work, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+int pool_init(WorkerPool* pool, int nthreads) {
+    pool->head = pool->tail = pool->delayed = NULL;
+    pool->pending_jobs = 0;
+    pool->stopping = 0;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&pool->work, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_cond_init(&pool->idle, NULL);
+    pool->threads = malloc(sizeof(pthread_t) * nthreads);
+    pool->nthreads = 0;
+    if (!pool->threads)
+        return -1;
+    for (int i = 0; i < nthreads; ++i) {
+        if (pthread_create(&pool->threads[i], NULL, pool_worker, pool) != 0)
+            break;
+        pool->nthreads++;
+    }
+    return pool->nthreads > 0 ? 0 : -1;
+}
+
+void pool_submit(WorkerPool* pool, Task* t) {
+    t->pool = pool;
+    t->next = NULL;
+    pthread_mutex_lock(&pool->lock);
+    if (pool->tail)
+        pool->tail->next = t;
+    else
+        pool->head = t;
+    pool->tail = t;
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Run t on a worker once delay_ms has elapsed
+void pool_submit_after(WorkerPool* pool, Task* t, int delay_ms) {
+    t->pool = pool;
+    clock_gettime(CLOCK_MONOTONIC, &t->due);
+    t->due.tv_sec += delay_ms / 1000;
+    t->due.tv_nsec += (delay_ms % 1000) * 1000000L;
+    if (t->due.tv_nsec >= 1000000000L) {
+        t->due.tv_sec++;
+        t->due.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&pool->lock);
+    Task** link = &pool->delayed;
+    while (*link && !timespec_before(&t->due, &(*link)->due))
+        link = &(*link)->next;
+    t->next = *link;
+    *link = t;
+    // A new earliest deadline: wake a worker so it re-arms its timeout
+    if (pool->delayed == t)
+        pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Jobs may span several tasks (and parked time); pool_wait_idle waits for all of them
+void pool_job_begin(WorkerPool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->pending_jobs++;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void pool_job_end(WorkerPool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    if (--pool->pending_jobs == 0)
+        pthread_cond_broadcast(&pool->idle);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void pool_wait_idle(WorkerPool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending_jobs > 0)
+        pthread_cond_wait(&pool->idle, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Runs every queued task that is already due, then joins the workers
+void pool_shutdown(WorkerPool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->nthreads; ++i)
+        pthread_join(pool->threads[i], NULL);
+    free(pool->threads);
+    pool->threads = NULL;
+    pool->nthreads = 0;
+}
+
+// ------------- BED INVENTORY -------------
+// Each ward tracks its own beds in a two-level free bitmap: a summary word
+// marks which 64-bed words still have a free bed, so find-first-set on the
+// summary and then on the word yields a free bed in O(1). Wards have their
+// own lock, so ICU and General traffic never contend with each other.
+// Requests that find the ward full are parked on the ward and resumed on
+// the worker pool with their bed already assigned when one is released.
+// Parked requests queue per severity, so a freed bed goes to exactly one
+// waiter: the most severe, first come first served within a severity.
+// A request whose task has no pool is resumed inline by ward_release.
+#define WARD_WAIT_LEVELS 10 // Severities 1-10
+typedef enum { WARD_LAYOUT(WARD_ENUM) WARD_COUNT } WardId;
+
+typedef struct Ward Ward;
+struct Hospital;
+
+typedef struct BedRequest {
+    Task task;       // Continuation; must stay first
+    Patient* patient;
+    int patient_id;
+    struct Hospital* hospital; // Owning shard; NULL in the simulator
+    Ward* ward;
+    int bed;
+    uint64_t requested_ns; // For the bed-wait histogram
+    struct BedRequest* next_waiter;
+} BedRequest;
+
+struct Ward {
+    _Alignas(CACHE_LINE) const char* name; // ICU and General allocate side by side without sharing a line
+    int capacity;
+    uint64_t summary;     // Bit w set: free_mask[w] != 0
+    uint64_t* free_mask;  // Bit set: bed free
+    int* occupant;        // Patient id per bed, 0 when empty
+    atomic_int occupied;
+    pthread_mutex_t lock;
+    BedRequest* wait_head[WARD_WAIT_LEVELS]; // Parked requests by severity - 1, FIFO each
+    BedRequest* wait_tail[WARD_WAIT_LEVELS];
+    uint32_t waiting;      // Bit s set: wait_head[s] != NULL
+};
+
+// Caller holds w->lock
+static void ward_mark_free(Ward* w, int bed) {
+    w->free_mask[bed >> 6] |= 1ULL << (bed & 63);
+    w->summary |= 1ULL << (bed >> 6);
+}
+
+// Caller holds w->lock
+static void ward_mark_used(Ward* w, int bed) {
+    w->free_mask[bed >> 6] &= ~(1ULL << (bed & 63));
+    if (!w->free_mask[bed >> 6])
+        w->summary &= ~(1ULL << (bed >> 6));
+}
+
+// Caller holds w->lock
+static int ward_take_free(Ward* w, int patient_id) {
+    if (!w->summary)
+        return -1;
+    int word = __builtin_ctzll(w->summary);
+    int bed = (word << 6) | __builtin_ctzll(w->free_mask[word]);
+    ward_mark_used(w, bed);
+    w->occupant[bed] = patient_id;
+    atomic_fetch_add(&w->occupied, 1);
+    return bed;
+}
+
+int ward_init(Ward* w, const char* name, int capacity) {
+    if (capacity < 0 || capacity > WARD_MAX_BEDS)
+        return -1;
+    int words = (capacity + 63) / 64;
+    w->name = name;
+    w->capacity = capacity;
+    w->summary = 0;
+    w->free_mask = calloc(words ? words : 1, sizeof(uint64_t));
+    w->occupant = calloc(capacity ? capacity : 1, sizeof(int));
+    if (!w->free_mask || !w->occupant)
+        return -1;
+    atomic_init(&w->occupied, 0);
+    pthread_mutex_init(&w->lock, NULL);
+    memset(w->wait_head, 0, sizeof(w->wait_head));
+    memset(w->wait_tail, 0, sizeof(w->wait_tail));
+    w->waiting = 0;
+    for (int bed = 0; bed < capacity; ++bed)
+        ward_mark_free(w, bed);
+    return 0;
+}
+
+void ward_destroy(Ward* w) {
+    free(w->free_mask);
+    free(w->occupant);
+    w->free_mask = NULL;
+    w->occupant = NULL;
+    pthread_mutex_destroy(&w->lock);
+}
+
+// Returns the bed index, or -1 if the ward is full
+int ward_try_alloc(Ward* w, int patient_id) {
+    pthread_mutex_lock(&w->lock);
+    int bed = ward_take_free(w, patient_id);
+    pthread_mutex_unlock(&w->lock);
+    return bed;
+}
+
+// Beds for ps[0..n) under one lock; returns how many got one (a prefix)
+int ward_alloc_batch(Ward* w, Patient* const* ps, int* beds, int n) {
+    pthread_mutex_lock(&w->lock);
+    int i = 0;
+    while (i < n && (beds[i] = ward_take_free(w, ps[i]->id)) >= 0)
+        i++;
+    pthread_mutex_unlock(&w->lock);
+    return i;
+}
+
+// Caller holds w->lock
+static void ward_wait_push(Ward* w, BedRequest* req) {
+    int sev = req->patient->severity;
+    int s = (sev < 1) ? 0 : (sev > WARD_WAIT_LEVELS) ? WARD_WAIT_LEVELS - 1 : sev - 1;
+    req->next_waiter = NULL;
+    if (w->wait_tail[s])
+        w->wait_tail[s]->next_waiter = req;
+    else
+        w->wait_head[s] = req;
+    w->wait_tail[s] = req;
+    w->waiting |= 1u << s;
+}
+
+// Most severe parked request, or NULL; caller holds w->lock
+static BedRequest* ward_wait_pop(Ward* w) {
+    if (!w->waiting)
+        return NULL;
+    int s = 31 - __builtin_clz(w->waiting);
+    BedRequest* req = w->wait_head[s];
+    w->wait_head[s] = req->next_waiter;
+    if (!w->wait_head[s]) {
+        w->wait_tail[s] = NULL;
+        w->waiting &= ~(1u << s);
+    }
+    return req;
+}
+
+// Returns the bed index, or -1 after parking req to be resumed with a bed
+int ward_alloc_or_park(Ward* w, BedRequest* req) {
+    pthread_mutex_lock(&w->lock);
+    int bed = ward_take_free(w, req->patient->id);
+    if (bed < 0)
+        ward_wait_push(w, req);
+    pthread_mutex_unlock(&w->lock);
+    return bed;
+}
+
+// Unpark the most severe waiter without giving it a bed (shutdown); NULL if none
+BedRequest* ward_cancel_waiter(Ward* w) {
+    pthread_mutex_lock(&w->lock);
+    BedRequest* req = ward_wait_pop(w);
+    pthread_mutex_unlock(&w->lock);
+    return req;
+}
+
+// Occupy a specific bed (journal replay); returns -1 if it is taken
+int ward_claim(Ward* w, int bed, int patient_id) {
+    if (bed < 0 || bed >= w->capacity)
+        return -1;
+    pthread_mutex_lock(&w->lock);
+    int ok = (w->free_mask[bed >> 6] >> (bed & 63)) & 1;
+    if (ok) {
+        ward_mark_used(w, bed);
+        w->occupant[bed] = patient_id;
+        atomic_fetch_add(&w->occupied, 1);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return ok ? 0 : -1;
+}
+
+// Returns the id of the patient who held the bed. If a request is parked,
+// the bed passes straight to the most severe one and only that
+// continuation is resubmitted.
+int ward_release(Ward* w, int bed) {
+    pthread_mutex_lock(&w->lock);
+    int id = w->occupant[bed];
+    BedRequest* next = ward_wait_pop(w);
+    if (next) {
+        w->occupant[bed] = next->patient->id;
+        next->bed = bed;
+    } else {
+        w->occupant[bed] = 0;
+        ward_mark_free(w, bed);
+        atomic_fetch_sub(&w->occupied, 1);
+    }
+    pthread_mutex_unlock(&w->lock);
+    // Requests without a pool (the simulator) resume inline
+    if (next && next->task.pool)
+        pool_submit(next->task.pool, &next->task);
+    else if (next)
+        next->task.fn(&next->task);
+    return id;
+}
+
+// Lowest occupied bed, or -1 if the ward is empty
+int ward_first_occupied(Ward* w) {
+    pthread_mutex_lock(&w->lock);
+    int bed = -1;
+    for (int word = 0; word * 64 < w->capacity && bed < 0; ++word) {
+        uint64_t used = ~w->free_mask[word];
+        int rem = w->capacity - word * 64;
+        if (rem < 64)
+            used &= (1ULL << rem) - 1;
+        if (used)
+            bed = (word << 6) | __builtin_ctzll(used);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return bed;
+}
+
+int ward_occupied(Ward* w) {
+    return atomic_load(&w->occupied);
+}
+
+int ward_free_beds(Ward* w) {
+    return w->capacity - atomic_load(&w->occupied);
+}
+
+// ------------- WARD LAYOUT -------------
+// Ward names and capacities are generated from WARD_LAYOUT. Direct bed
+// requests (allocate_bed) are routed by a flat type x severity table, so
+// picking their ward is one load instead of a branch on the type. Check-ins
+// through add_patient go through the triage queue into the admission ward
+// whatever their type. A --wards file can override both at startup:
+//   beds <ward> <n>                   capacity of a ward
+//   route <GENERAL|ICU> <lo>[-<hi>] <ward>   severities lo..hi go to ward
+//   stay <ward> <secs>                expected length of stay, 0: until discharged by hand
+// Later lines win.
+static const char* const ward_names[WARD_COUNT] = { WARD_LAYOUT(WARD_NAME) };
+static int ward_beds[WARD_COUNT] = { WARD_LAYOUT(WARD_BEDS) };
+static int ward_stay_ms[WARD_COUNT] = { WARD_LAYOUT(WARD_STAY) };
+
+static unsigned char ward_route[PATIENT_TYPE_COUNT][WARD_WAIT_LEVELS + 1] = {
+    [GENERAL] = { [0 ... WARD_WAIT_LEVELS] = WARD_GENERAL },
+    [ICU]     = { [0 ... WARD_WAIT_LEVELS] = WARD_ICU },
+};
+
+static inline WardId ward_for(const Patient* p) {
+    int sev = p->severity;
+    sev = (sev < 0) ? 0 : (sev > WARD_WAIT_LEVELS) ? WARD_WAIT_LEVELS : sev;
+    return (WardId)ward_route[(unsigned)p->type < PATIENT_TYPE_COUNT ? p->type : GENERAL][sev];
+}
+
+// Sicker patients are expected to stay longer: severity 5 gets the ward's
+// mean stay, 1 gets 60% of it and 10 gets 150%. 0 means no expected discharge.
+static int ward_expected_stay_ms(const Patient* p, int ward) {
+    int sev = p->severity < 1 ? 1 : p->severity > 10 ? 10 : p->severity;
+    return (int)((long long)ward_stay_ms[ward] * (5 + sev) / 10);
+}
+
+// Case-insensitive ward name lookup; WARD_COUNT if unknown
+WardId ward_parse(const char* name) {
+    for (int i = 0; i < WARD_COUNT; ++i)
+        if (strcasecmp(name, ward_names[i]) == 0)
+            return (WardId)i;
+    return WARD_COUNT;
+}
+
+// Apply a --wards file; returns 0, or -1 after reporting the bad line
+int ward_layout_load(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "[ERROR] Cannot open ward layout %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    char line[256];
+    int lineno = 0, rc = 0;
+    while (rc == 0 && fgets(line, sizeof(line), f)) {
+        ++lineno;
+        char verb[16], a[32], b[32], c[32];
+        int n = sscanf(line, "%15s %31s %31s %31s", verb, a, b, c);
+        if (n <= 0 || verb[0] == '#')
+            continue;
+        if (strcasecmp(verb, "beds") == 0 && n == 3) {
+            WardId w = ward_parse(a);
+            char* end;
+            long beds = strtol(b, &end, 10);
+            if (w == WARD_COUNT || *end || beds < 0 || beds > WARD_MAX_BEDS)
+                rc = -1;
+            else
+                ward_beds[w] = (int)beds;
+        } else if (strcasecmp(verb, "stay") == 0 && n == 3) {
+            WardId w = ward_parse(a);
+            char* end;
+            double secs = strtod(b, &end);
+            if (w == WARD_COUNT || *end || secs < 0 || secs > WARD_MAX_STAY_SECS)
+                rc = -1;
+            else
+                ward_stay_ms[w] = (int)(secs * 1000.0);
+        } else if (strcasecmp(verb, "route") == 0 && n == 4) {
+            PatientType type = strcasecmp(a, "ICU") == 0 ? ICU
+                             : strcasecmp(a, "GENERAL") == 0 ? GENERAL : PATIENT_TYPE_COUNT;
+            WardId w = ward_parse(c);
+            int lo, hi;
+            int got = sscanf(b, "%d-%d", &lo, &hi);
+            if (got == 1)
+                hi = lo;
+            if (type == PATIENT_TYPE_COUNT || w == WARD_COUNT || w == WARD_ADMISSION || got < 1
+                || lo < 0 || hi < lo || hi > WARD_WAIT_LEVELS)
+                rc = -1;
+            else
+                for (int sev = lo; sev <= hi; ++sev)
+                    ward_route[type][sev] = (unsigned char)w;
+        } else {
+            rc = -1;
+        }
+    }
+    if (rc < 0)
+        fprintf(stderr, "[ERROR] %s:%d: expected 'beds <ward> <n>', 'stay <ward> <secs>' or 'route <GENERAL|ICU> <lo>[-<hi>] <ward>'\n",
+                path, lineno);
+    fclose(f);
+    return rc;
+}
+
+// ------------- TIMER WHEEL -------------
+// Hierarchical timing wheel for expected discharges, one per shard. Level l
+// has WHEEL_SLOTS slots, each WHEEL_SLOTS^l ticks wide; a timer sits in the
+// lowest level whose span covers its delay. Scheduling and cancelling are
+// O(1) list operations on the Patient's intrusive WheelTimer. Whenever a
+// level completes a rotation the next slot of the level above is cascaded
+// down, so a timer moves at most WHEEL_LEVELS - 1 times before it fires.
+// Delays beyond the top level's span fire at the end of it.
+#define WHEEL_TICK_MS 100
+#define WHEEL_SLOT_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_SLOT_BITS)
+#define WHEEL_LEVELS 4
+#define WHEEL_SPAN ((uint64_t)1 << (WHEEL_SLOT_BITS * WHEEL_LEVELS)) // Ticks, about 19 days
+#define FORECAST_HORIZONS 3
+
+static const int forecast_horizon_secs[FORECAST_HORIZONS] = { 60, 900, 3600 };
+static const char* const forecast_horizon_names[FORECAST_HORIZONS] = { "1m", "15m", "1h" };
+
+typedef struct {
+    WheelTimer slots[WHEEL_LEVELS][WHEEL_SLOTS];       // List heads
+    int counts[WHEEL_LEVELS][WHEEL_SLOTS][WARD_COUNT]; // Timers per slot and ward
+    uint64_t now;                                      // Last tick processed
+    uint64_t origin_ns;                                // Monotonic time of tick 0
+    pthread_mutex_t lock;
+    // Discharges due within each horizon, refreshed by wheel_forecast
+    atomic_int due_within[WARD_COUNT][FORECAST_HORIZONS];
+} TimerWheel;
+
+void wheel_init(TimerWheel* w) {
+    memset(w, 0, sizeof(*w));
+    for (int l = 0; l < WHEEL_LEVELS; ++l)
+        for (int s = 0; s < WHEEL_SLOTS; ++s)
+            w->slots[l][s].next = w->slots[l][s].prev = &w->slots[l][s];
+    w->origin_ns = now_ns();
+    pthread_mutex_init(&w->lock, NULL);
+}
+
+static uint64_t wheel_tick_at(const TimerWheel* w, uint64_t ns) {
+    return (ns - w->origin_ns) / (WHEEL_TICK_MS * 1000000ull);
+}
+
+static Patient* wheel_patient(WheelTimer* t) {
+    return (Patient*)((char*)t - offsetof(Patient, discharge));
+}
+
+// Caller holds w->lock; w->now < t->due < w->now + WHEEL_SPAN
+static void wheel_place(TimerWheel* w, WheelTimer* t) {
+    uint64_t delta = t->due - w->now;
+    int l = 0;
+    while (l < WHEEL_LEVELS - 1 && delta >= (uint64_t)1 << (WHEEL_SLOT_BITS * (l + 1)))
+        l++;
+    int s = (int)((t->due >> (WHEEL_SLOT_BITS * l)) & (WHEEL_SLOTS - 1));
+    WheelTimer* head = &w->slots[l][s];
+    t->next = head;
+    t->prev = head->prev;
+    head->prev->next = t;
+    head->prev = t;
+    t->slot = l * WHEEL_SLOTS + s;
+    w->counts[l][s][t->ward]++;
+}
+
+// Caller holds w->lock; t is scheduled
+static void wheel_unlink(TimerWheel* w, WheelTimer* t) {
+    t->prev->next = t->next;
+    t->next->prev = t->prev;
+    t->next = t->prev = NULL;
+    w->counts[t->slot / WHEEL_SLOTS][t->slot % WHEEL_SLOTS][t->ward]--;
+}
+
+// Caller holds w->lock
+static void wheel_arm_locked(TimerWheel* w, Patient* p, int ward, int bed, uint64_t tick) {
+    WheelTimer* t = &p->discharge;
+    if (t->next)
+        wheel_unlink(w, t);
+    int stay = ward_expected_stay_ms(p, ward);
+    if (stay <= 0)
+        return;
+    uint64_t due = tick + ((uint64_t)stay + WHEEL_TICK_MS - 1) / WHEEL_TICK_MS;
+    if (due <= w->now)
+        due = w->now + 1;
+    if (due - w->now >= WHEEL_SPAN)
+        due = w->now + WHEEL_SPAN - 1;
+    t->due = due;
+    t->ward = ward;
+    t->bed = bed;
+    wheel_place(w, t);
+}
+
+// (Re)arm p's discharge from (ward, bed) for its expected stay in ward,
+// starting now. A ward without an expected stay only cancels any earlier timer.
+void wheel_schedule(TimerWheel* w, Patient* p, int ward, int bed) {
+    uint64_t tick = wheel_tick_at(w, now_ns());
+    pthread_mutex_lock(&w->lock);
+    wheel_arm_locked(w, p, ward, bed, tick);
+    pthread_mutex_unlock(&w->lock);
+}
+
+// Same for a batch of admissions, under one lock acquisition
+void wheel_schedule_batch(TimerWheel* w, Patient* const* ps, const int* beds, int n, int ward) {
+    if (n == 0 || ward_stay_ms[ward] <= 0)
+        return;
+    uint64_t tick = wheel_tick_at(w, now_ns());
+    pthread_mutex_lock(&w->lock);
+    for (int i = 0; i < n; ++i)
+        wheel_arm_locked(w, ps[i], ward, beds[i], tick);
+    pthread_mutex_unlock(&w->lock);
+}
+
+// Disarm p's timer, if any; call before the record is freed
+void wheel_cancel(TimerWheel* w, Patient* p) {
+    pthread_mutex_lock(&w->lock);
+    if (p->discharge.next)
+        wheel_unlink(w, &p->discharge);
+    pthread_mutex_unlock(&w->lock);
+}
+
+// Caller holds w->lock
+static void wheel_cascade(TimerWheel* w, int level, int slot) {
+    WheelTimer* head = &w->slots[level][slot];
+    if (head->next == head)
+        return;
+    WheelTimer* t = head->next;
+    head->prev->next = NULL;
+    head->next = head->prev = head;
+    memset(w->counts[level][slot], 0, sizeof(w->counts[level][slot]));
+    while (t) {
+        WheelTimer* next = t->next;
+        wheel_place(w, t);
+        t = next;
+    }
+}
+
+// A timer that fired, with the bed it was armed for
+typedef struct {
+    int patient_id;
+    int ward;
+    int bed;
+} WheelExpiry;
+
+// Advance the wheel to tick, collecting the patients whose expected stay
+// has run out; their timers are disarmed. Stops once max are collected and
+// resumes from there on the next call. Returns the count.
+int wheel_expire(TimerWheel* w, uint64_t tick, WheelExpiry* out, int max) {
+    int n = 0;
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        WheelTimer* head = &w->slots[0][w->now & (WHEEL_SLOTS - 1)];
+        while (head->next != head && n < max) {
+            WheelTimer* t = head->next;
+            wheel_unlink(w, t);
+            out[n++] = (WheelExpiry){ wheel_patient(t)->id, t->ward, t->bed };
+        }
+        if (n == max || w->now >= tick)
+            break;
+        w->now++;
+        for (int l = 1; l < WHEEL_LEVELS; ++l) {
+            int shift = WHEEL_SLOT_BITS * l;
+            if (w->now & (((uint64_t)1 << shift) - 1))
+                break;
+            wheel_cascade(w, l, (int)((w->now >> shift) & (WHEEL_SLOTS - 1)));
+        }
+    }
+    pthread_mutex_unlock(&w->lock);
+    return n;
+}
+
+// Count the timers due within each forecast horizon, per ward. Every slot
+// covers a known block of ticks, so whole blocks inside the horizon are
+// summed from the slot counts and only the block straddling it is walked.
+void wheel_forecast(TimerWheel* w) {
+    int due[WARD_COUNT][FORECAST_HORIZONS] = { { 0 } };
+    pthread_mutex_lock(&w->lock);
+    for (int f = 0; f < FORECAST_HORIZONS; ++f) {
+        uint64_t limit = w->now + (uint64_t)forecast_horizon_secs[f] * 1000 / WHEEL_TICK_MS;
+        for (int l = 0; l < WHEEL_LEVELS; ++l) {
+            int shift = WHEEL_SLOT_BITS * l;
+            uint64_t first = (l == 0) ? w->now : (w->now >> shift) + 1;
+            for (int k = 0; k < WHEEL_SLOTS; ++k) {
+                uint64_t block = first + k;
+                if (block << shift > limit)
+                    break;
+                int s = (int)(block & (WHEEL_SLOTS - 1));
+                if (((block + 1) << shift) - 1 <= limit) {
+                    for (int ward = 0; ward < WARD_COUNT; ++ward)
+                        due[ward][f] += w->counts[l][s][ward];
+                    continue;
+                }
+                for (WheelTimer* t = w->slots[l][s].next; t != &w->slots[l][s]; t = t->next)
+                    if (t->due <= limit)
+                        due[t->ward][f]++;
+            }
+        }
+    }
+    pthread_mutex_unlock(&w->lock);
+    for (int ward = 0; ward < WARD_COUNT; ++ward)
+        for (int f = 0; f < FORECAST_HORIZONS; ++f)
+            atomic_store_explicit(&w->due_within[ward][f], due[ward][f], memory_order_relaxed);
+}
+
+// ------------- CENSUS STREAM -------------
+// Versioned change feed, one per shard, for displays that want deltas
+// instead of polling STATUS. Every change gets the next version and goes
+// into a fixed ring. A bed taking or losing a patient is appended by the
+// occupant index as it changes. The queue depth and head-of-queue patient
+// are sampled by the wheel thread each tick, so check-in bursts coalesce.
+// A reader asks for everything after the last version it saw. If that
+// version has already left the ring, the reader takes a snapshot
+// (occ_census_snapshot) and continues from that snapshot's version.
+// Entries carry absolute state ("bed 3 holds patient 17"), so replaying
+// one a snapshot already reflects is harmless. Versions
+// start from the wall clock in microseconds, so a restarted process never
+// reuses a version an old subscriber could hold.
+#define CENSUS_LOG_SLOTS 4096 // Power of two
+
+typedef enum { CENSUS_BED, CENSUS_QUEUE, CENSUS_HEAD } CensusKind;
+
+typedef struct {
+    uint64_t version;
+    uint8_t kind;       // CensusKind
+    uint8_t ward;       // CENSUS_BED
+    int32_t bed;        // CENSUS_BED
+    int32_t patient_id; // CENSUS_BED: occupant, 0 when freed; CENSUS_HEAD: head, 0 when empty
+    int32_t value;      // CENSUS_QUEUE: depth; CENSUS_HEAD: triage level
+} CensusDelta;
+
+typedef struct {
+    pthread_mutex_t lock;
+    CensusDelta* ring;
+    uint64_t first;   // Version before the first entry ever appended
+    _Atomic uint64_t version; // Latest version; written under lock
+    int queued;       // Last sampled queue depth
+    int head_id;      // Last sampled head
+    int head_level;
+} CensusLog;
+
+// Poked (once per burst) after an append; set by whoever streams the feed
+static int census_notify_fd = -1;
+static atomic_int census_notify_pending;
+
+void census_init(CensusLog* c) {
+    pthread_mutex_init(&c->lock, NULL);
+    c->ring = calloc(CENSUS_LOG_SLOTS, sizeof(CensusDelta));
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    c->first = (uint64_t)ts.tv_sec * 1000000ull + (uint64_t)ts.tv_nsec / 1000;
+    atomic_init(&c->version, c->first);
+    c->queued = 0;
+    c->head_id = 0;
+    c->head_level = -1;
+}
+
+void census_destroy(CensusLog* c) {
+    free(c->ring);
+    c->ring = NULL;
+    pthread_mutex_destroy(&c->lock);
+}
+
+// Caller holds c->lock
+static void census_append_locked(CensusLog* c, CensusDelta d) {
+    uint64_t v = atomic_load_explicit(&c->version, memory_order_relaxed) + 1;
+    d.version = v;
+    if (c->ring)
+        c->ring[v & (CENSUS_LOG_SLOTS - 1)] = d;
+    atomic_store_explicit(&c->version, v, memory_order_release);
+}
+
+static void census_notify(void) {
+    if (census_notify_fd < 0 || atomic_exchange(&census_notify_pending, 1))
+        return;
+    uint64_t one = 1;
+    ssize_t rc = write(census_notify_fd, &one, sizeof(one));
+    (void)rc;
+}
+
+// Bed of ward now holds patient_id (0: free). The occupant index calls
+// these under its lock, so entries are in the order the index changed.
+void census_bed(CensusLog* c, int ward, int bed, int patient_id) {
+    pthread_mutex_lock(&c->lock);
+    census_append_locked(c, (CensusDelta){ .kind = CENSUS_BED, .ward = (uint8_t)ward, .bed = bed, .patient_id = patient_id });
+    pthread_mutex_unlock(&c->lock);
+    census_notify();
+}
+
+// A batch of admissions into one ward, under one lock round trip
+void census_beds(CensusLog* c, int ward, const int* beds, Patient* const* ps, int n) {
+    if (n <= 0)
+        return;
+    pthread_mutex_lock(&c->lock);
+    for (int i = 0; i < n; ++i)
+        census_append_locked(c, (CensusDelta){ .kind = CENSUS_BED, .ward = (uint8_t)ward, .bed = beds[i],
+                                               .patient_id = ps[i]->id });
+    pthread_mutex_unlock(&c->lock);
+    census_notify();
+}
+
+// Record the queue depth and head if they changed since the last sample
+void census_sample(CensusLog* c, PriorityQueue* pq) {
+    int queued = pq_size(pq);
+    int level;
+    int head = pq_peek_head(pq, &level);
+    pthread_mutex_lock(&c->lock);
+    int changed = 0;
+    if (queued != c->queued) {
+        c->queued = queued;
+        census_append_locked(c, (CensusDelta){ .kind = CENSUS_QUEUE, .value = queued });
+        changed = 1;
+    }
+    if (head != c->head_id || level != c->head_level) {
+        c->head_id = head;
+        c->head_level = level;
+        census_append_locked(c, (CensusDelta){ .kind = CENSUS_HEAD, .patient_id = head, .value = level });
+        changed = 1;
+    }
+    pthread_mutex_unlock(&c->lock);
+    if (changed)
+        census_notify();
+}
+
+uint64_t census_version(CensusLog* c) {
+    return atomic_load_explicit(&c->version, memory_order_acquire);
+}
+
+// Copy up to max entries after version since into out and set *latest.
+// Returns how many, or -1 if since is no longer (or never was) in the ring
+// and the reader must start over from occ_census_snapshot.
+long census_read(CensusLog* c, uint64_t since, CensusDelta* out, int max, uint64_t* latest) {
+    pthread_mutex_lock(&c->lock);
+    uint64_t v = atomic_load_explicit(&c->version, memory_order_relaxed);
+    *latest = v;
+    long n = -1;
+    if (c->ring && since >= c->first && since <= v && v - since <= CENSUS_LOG_SLOTS) {
+        n = (long)(v - since) < max ? (long)(v - since) : max;
+        for (long i = 0; i < n; ++i)
+            out[i] = c->ring[(since + 1 + (uint64_t)i) & (CENSUS_LOG_SLOTS - 1)];
+    }
+    pthread_mutex_unlock(&c->lock);
+    return n;
+}
+
+// One line for an entry, after a "DELTA <version> " prefix or in a snapshot
+void census_format(const CensusDelta* d, char* out, size_t len) {
+    if (d->kind == CENSUS_BED)
+        snprintf(out, len, "BED %s %d %d", d->ward < WARD_COUNT ? ward_names[d->ward] : "?", d->bed, d->patient_id);
+    else if (d->kind == CENSUS_QUEUE)
+        snprintf(out, len, "QUEUE %d", d->value);
+    else
+        snprintf(out, len, "HEAD %d %d", d->patient_id, d->value);
+}
+
+// ------------- OCCUPANT INDEX -------------
+// Open-addressed hash of patient id -> (ward, bed, record) for everyone who
+// currently holds a bed. It owns the Patient records of admitted patients,
+// so discharge and transfer by id are O(1) and no ward scan is needed.
+// With a wheel attached, insert and move (re)arm the occupant's expected
+// discharge and remove disarms it, all under the index lock, so a timer is
+// never armed on a record another thread has already removed and freed.
+// With a census attached, every change is also appended to it under the
+// same lock, so the feed's order is the index's order.
+#define OCC_INITIAL_CAPACITY 64
+#define OCC_EMPTY 0
+#define OCC_TOMBSTONE -1
+
+typedef struct {
+    int patient_id; // OCC_EMPTY, OCC_TOMBSTONE or a patient id
+    int ward;
+    int bed;
+    Patient* patient;
+} OccupantEntry;
+
+typedef struct {
+    OccupantEntry* slots;
+    size_t capacity; // Power of two
+    size_t count;
+    size_t tombstones;
+    TimerWheel* wheel; // Optional; lock order is index, then wheel
+    CensusLog* census; // Optional; lock order is index, then census
+    pthread_mutex_t lock;
+} OccupantIndex;
+
+int occ_init(OccupantIndex* idx) {
+    idx->capacity = OCC_INITIAL_CAPACITY;
+    idx->slots = calloc(idx->capacity, sizeof(OccupantEntry));
+    idx->count = idx->tombstones = 0;
+    idx->wheel = NULL;
+    idx->census = NULL;
+    pthread_mutex_init(&idx->lock, NULL);
+    return idx->slots ? 0 : -1;
+}
+
+// Frees any records still held
+void occ_destroy(OccupantIndex* idx) {
+    pthread_mutex_lock(&idx->lock);
+    for (size_t i = 0; i < idx->capacity; ++i)
+        if (idx->slots[i].patient_id > 0)
+            patient_free(idx->slots[i].patient);
+    free(idx->slots);
+    idx->slots = NULL;
+    idx->capacity = idx->count = idx->tombstones = 0;
+    pthread_mutex_unlock(&idx->lock);
+}
+
+// Slot holding id, or the first reusable slot on its probe path when absent.
+// Caller holds idx->lock
+static OccupantEntry* occ_probe(OccupantIndex* idx, int id) {
+    size_t mask = idx->capacity - 1;
+    size_t i = ((uint32_t)id * 2654435761u) & mask;
+    OccupantEntry* reuse = NULL;
+    for (;;) {
+        OccupantEntry* e = &idx->slots[i];
+        if (e->patient_id == id)
+            return e;
+        if (e->patient_id == OCC_EMPTY)
+            return reuse ? reuse : e;
+        if (e->patient_id == OCC_TOMBSTONE && !reuse)
+            reuse = e;
+        i = (i + 1) & mask;
+    }
+}
+
+// Caller holds idx->lock
+static int occ_rehash(OccupantIndex* idx, size_t capacity) {
+    OccupantEntry* old = idx->slots;
+    size_t old_cap = idx->capacity;
+    OccupantEntry* slots = calloc(capacity, sizeof(OccupantEntry));
+    if (!slots)
+        return -1;
+    idx->slots = slots;
+    idx->capacity = capacity;
+    idx->tombstones = 0;
+    for (size_t i = 0; i < old_cap; ++i)
+        if (old[i].patient_id > 0)
+            *occ_probe(idx, old[i].patient_id) = old[i];
+    free(old);
+    return 0;
+}
+
+// Caller holds idx->lock
+static int occ_insert_locked(OccupantIndex* idx, int id, int ward, int bed, Patient* p) {
+    if ((idx->count + idx->tombstones + 1) * 10 > idx->capacity * 7) {
+        size_t cap = (idx->count + 1) * 10 > idx->capacity * 5 ? idx->capacity * 2 : idx->capacity;
+        if (occ_rehash(idx, cap) < 0)
+            return -1;
+    }
+    OccupantEntry* e = occ_probe(idx, id);
+    if (e->patient_id != id) {
+        if (e->patient_id == OCC_TOMBSTONE)
+            idx->tombstones--;
+        idx->count++;
+    }
+    e->patient_id = id;
+    e->ward = ward;
+    e->bed = bed;
+    e->patient = p;
+    return 0;
+}
+
+int occ_insert(OccupantIndex* idx, int id, int ward, int bed, Patient* p) {
+    pthread_mutex_lock(&idx->lock);
+    int rc = occ_insert_locked(idx, id, ward, bed, p);
+    if (rc == 0 && idx->wheel)
+        wheel_schedule(idx->wheel, p, ward, bed);
+    if (rc == 0 && idx->census)
+        census_bed(idx->census, ward, bed, id);
+    pthread_mutex_unlock(&idx->lock);
+    return rc;
+}
+
+// Insert n patients under one lock; returns how many were inserted (a prefix)
+int occ_insert_batch(OccupantIndex* idx, int ward, Patient* const* ps, const int* beds, int n) {
+    pthread_mutex_lock(&idx->lock);
+    int i = 0;
+    while (i < n && occ_insert_locked(idx, ps[i]->id, ward, beds[i], ps[i]) == 0)
+        i++;
+    if (idx->wheel)
+        wheel_schedule_batch(idx->wheel, ps, beds, i, ward);
+    if (idx->census)
+        census_beds(idx->census, ward, beds, ps, i);
+    pthread_mutex_unlock(&idx->lock);
+    return i;
+}
+
+int occ_lookup(OccupantIndex* idx, int id, OccupantEntry* out) {
+    pthread_mutex_lock(&idx->lock);
+    OccupantEntry* e = occ_probe(idx, id);
+    int found = (e->patient_id == id);
+    if (found && out)
+        *out = *e;
+    pthread_mutex_unlock(&idx->lock);
+    return found ? 0 : -1;
+}
+
+// Remove id only if it still sits in (ward, bed), so a racing transfer or
+// discharge cannot make us free the wrong bed. Returns 0 on success.
+int occ_remove_at(OccupantIndex* idx, int id, int ward, int bed, OccupantEntry* out) {
+    pthread_mutex_lock(&idx->lock);
+    OccupantEntry* e = occ_probe(idx, id);
+    int ok = (e->patient_id == id && e->ward == ward && e->bed == bed);
+    if (ok) {
+        if (out)
+            *out = *e;
+        if (idx->wheel)
+            wheel_cancel(idx->wheel, e->patient);
+        if (idx->census)
+            census_bed(idx->census, ward, bed, 0);
+        e->patient_id = OCC_TOMBSTONE;
+        e->patient = NULL;
+        idx->count--;
+        idx->tombstones++;
+    }
+    pthread_mutex_unlock(&idx->lock);
+    return ok ? 0 : -1;
+}
+
+// Move id from (ward, bed) to (to_ward, to_bed); fails if it moved meanwhile.
+// The record is copied into *moved first: once the lock drops, a discharge
+// from the new ward (or its re-armed timer) may free it.
+int occ_move(OccupantIndex* idx, int id, int ward, int bed, int to_ward, int to_bed, Patient* moved) {
+    pthread_mutex_lock(&idx->lock);
+    OccupantEntry* e = occ_probe(idx, id);
+    int ok = (e->patient_id == id && e->ward == ward && e->bed == bed);
+    if (ok) {
+        *moved = *e->patient;
+        e->ward = to_ward;
+        e->bed = to_bed;
+        if (idx->wheel)
+            wheel_schedule(idx->wheel, e->patient, to_ward, to_bed); // The stay restarts in the new ward
+        if (idx->census) {
+            census_bed(idx->census, to_ward, to_bed, id);
+            census_bed(idx->census, ward, bed, 0);
+        }
+    }
+    pthread_mutex_unlock(&idx->lock);
+    return ok ? 0 : -1;
+}
+
+// Copy every occupied bed, then the census's last queue depth and head,
+// into a malloc'd array at *out, all stamped with the census version they
+// are current as of. Both locks are held only for the copy, so formatting
+// the result stalls no admission or discharge. Returns the entry count
+// (at least 2), or -1 if out of memory; the caller frees *out.
+long occ_census_snapshot(OccupantIndex* idx, CensusDelta** out) {
+    CensusLog* c = idx->census;
+    pthread_mutex_lock(&idx->lock);
+    pthread_mutex_lock(&c->lock);
+    CensusDelta* d = malloc(sizeof(CensusDelta) * (idx->count + 2));
+    long n = 0;
+    if (d) {
+        uint64_t v = atomic_load_explicit(&c->version, memory_order_relaxed);
+        for (size_t i = 0; i < idx->capacity; ++i) {
+            const OccupantEntry* e = &idx->slots[i];
+            if (e->patient_id <= 0)
+                continue;
+            d[n++] = (CensusDelta){ .version = v, .kind = CENSUS_BED, .ward = (uint8_t)e->ward, .bed = e->bed,
+                                    .patient_id = e->patient_id };
+        }
+        d[n++] = (CensusDelta){ .version = v, .kind = CENSUS_QUEUE, .value = c->queued };
+        d[n++] = (CensusDelta){ .version = v, .kind = CENSUS_HEAD, .patient_id = c->head_id, .value = c->head_level };
+    }
+    pthread_mutex_unlock(&c->lock);
+    pthread_mutex_unlock(&idx->lock);
+    *out = d;
+    return d ? n : -1;
+}
+
+// ------------- EVENT STORE -------------
+// Binary audit trail kept by the logger next to hospital.log. Events are
+// appended to one segment per UTC day (<dir>/YYYY-MM-DD.seg) of fixed-size
+// records carrying event type, ward and bed. When the day rolls over or the
+// logger closes, the segment is sealed: <dir>/YYYY-MM-DD.idx holds its
+// record numbers sorted by (event, patient id), (event, MRN) and
+// (event, name key). A query only opens the segments in its date range,
+// binary-searches their indexes for the event and patient it asks about,
+// and scans just the records appended since the last seal.
+#define EVENTS_DAY_SECS 86400
+#define EVENTS_IDX_MAGIC 0x49564548u // "HEVI"
+#define EVENTS_IDX_VERSION 1
+#define EVENTS_DEFAULT_DIR "hospital.events"
+
+typedef enum { LOG_EV_CHECKIN, LOG_EV_ADMITTED, LOG_EV_DISCHARGED, LOG_EV_TRANSFERRED, LOG_EV_COUNT } LogEvent;
+
+static const char* const log_event_names[LOG_EV_COUNT] = { "Check-In", "Admitted", "Discharged", "Transferred" };
+static const char* const patient_type_names[PATIENT_TYPE_COUNT] = { "REGULAR", "EMERGENCY", "GENERAL", "ICU" };
+
+typedef struct {
+    int64_t time;       // Seconds since the epoch
+    uint64_t mrn;       // 0: none
+    uint64_t name_key;  // events_name_key() of the name, 0: anonymous
+    int32_t patient_id;
+    int16_t bed;        // -1: none
+    uint8_t event;      // LogEvent
+    uint8_t ward;       // WardId, WARD_COUNT: none
+    uint8_t patient_type;
+    uint8_t severity;
+    uint8_t reserved[6];
+} EventRecord;
+
+typedef enum { EVENTS_KEY_ID, EVENTS_KEY_MRN, EVENTS_KEY_NAME, EVENTS_KEY_COUNT } EventKeyKind;
+
+typedef struct {
+    uint64_t key;
+    uint32_t rec;   // Record number within the segment
+    uint32_t event;
+} EventIndexEntry;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t records;                   // Leading records of the segment it covers
+    uint64_t entries[EVENTS_KEY_COUNT]; // Entries per key kind; the arrays follow in this order
+} EventIndexHeader;
+
+typedef struct {
+    char dir[256];
+    FILE* seg;   // Current day's segment, appended by the log writer
+    int64_t day; // Day number of seg
+} EventStore;
+
+static EventStore events = { .day = -1 };
+
+static uint64_t events_name_key(const char* name) {
+    if (!*name)
+        return 0;
+    uint64_t h = 14695981039346656037ull; // FNV-1a, 64-bit
+    while (*name)
+        h = (h ^ (unsigned char)*name++) * 1099511628211ull;
+    return h ? h : 1;
+}
+
+static void events_path(const char* dir, int64_t day, const char* ext, char* out, size_t len) {
+    time_t t = (time_t)(day * EVENTS_DAY_SECS);
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    snprintf(out, len, "%s/%04d-%02d-%02d.%s", dir, tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, ext);
+}
+
+// Map a whole file read-only; *len is 0 (and NULL returned) for an empty or missing file
+static void* events_map(const char* path, size_t* len) {
+    *len = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    void* base = NULL;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED)
+            base = NULL;
+        else
+            *len = (size_t)st.st_size;
+    }
+    close(fd);
+    return base;
+}
+
+static int events_cmp_entry(const void* a, const void* b) {
+    const EventIndexEntry* x = a;
+    const EventIndexEntry* y = b;
+    if (x->event != y->event)
+        return x->event < y->event ? -1 : 1;
+    if (x->key != y->key)
+        return x->key < y->key ? -1 : 1;
+    return x->rec < y->rec ? -1 : x->rec > y->rec;
+}
+
+static uint64_t events_record_key(const EventRecord* r, EventKeyKind kind) {
+    return kind == EVENTS_KEY_ID ? (uint64_t)(uint32_t)r->patient_id : kind == EVENTS_KEY_MRN ? r->mrn : r->name_key;
+}
+
+// Build <day>.idx over every complete record of <day>.seg
+static int events_seal(const char* dir, int64_t day) {
+    char path[sizeof(events.dir) + 32], tmp[sizeof(path) + 8];
+    events_path(dir, day, "seg", path, sizeof(path));
+    size_t len;
+    const EventRecord* recs = events_map(path, &len);
+    size_t n = len / sizeof(EventRecord);
+    EventIndexHeader hdr = { .magic = EVENTS_IDX_MAGIC, .version = EVENTS_IDX_VERSION, .records = n };
+    EventIndexEntry* entries[EVENTS_KEY_COUNT] = { NULL };
+    int rc = 0;
+    for (int k = 0; k < EVENTS_KEY_COUNT && rc == 0; ++k) {
+        entries[k] = malloc(sizeof(EventIndexEntry) * (n ? n : 1));
+        if (!entries[k]) {
+            rc = -1;
+            break;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            uint64_t key = events_record_key(&recs[i], (EventKeyKind)k);
+            if (key || k == EVENTS_KEY_ID)
+                entries[k][hdr.entries[k]++] = (EventIndexEntry){ key, (uint32_t)i, recs[i].event };
+        }
+        qsort(entries[k], hdr.entries[k], sizeof(EventIndexEntry), events_cmp_entry);
+    }
+    if (recs)
+        munmap((void*)recs, len);
+    events_path(dir, day, "idx", path, sizeof(path));
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE* f = rc == 0 ? fopen(tmp, "wb") : NULL;
+    if (f) {
+        int ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+        for (int k = 0; k < EVENTS_KEY_COUNT; ++k)
+            ok = ok && fwrite(entries[k], sizeof(EventIndexEntry), hdr.entries[k], f) == hdr.entries[k];
+        ok = (fclose(f) == 0) && ok;
+        rc = (ok && rename(tmp, path) == 0) ? 0 : -1;
+        if (rc < 0)
+            unlink(tmp);
+    } else {
+        rc = -1;
+    }
+    for (int k = 0; k < EVENTS_KEY_COUNT; ++k)
+        free(entries[k]);
+    if (rc < 0)
+        fprintf(stderr, "[ERROR] Could not index event segment %s: %s\n", path, strerror(errno));
+    return rc;
+}
+
+// Start recording into dir, creating it if needed; returns 0 or -1
+int events_open(const char* dir) {
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+        fprintf(stderr, "[ERROR] Cannot create event store %s: %s\n", dir, strerror(errno));
+        return -1;
+    }
+    snprintf(events.dir, sizeof(events.dir), "%s", dir);
+    events.day = -1;
+    return 0;
+}
+
+// Caller holds log_lock; rolls to a new segment when r is from a new day
+static void events_append(const EventRecord* r) {
+    if (!events.dir[0])
+        return;
+    int64_t day = r->time / EVENTS_DAY_SECS;
+    if (day != events.day) {
+        if (events.seg) {
+            fclose(events.seg);
+            events.seg = NULL;
+            events_seal(events.dir, events.day);
+        }
+        char path[sizeof(events.dir) + 32];
+        events_path(events.dir, day, "seg", path, sizeof(path));
+        events.seg = fopen(path, "ab");
+        events.day = day;
+        if (!events.seg) {
+            fprintf(stderr, "[ERROR] Cannot open event segment %s: %s\n", path, strerror(errno));
+            return;
+        }
+    }
+    if (events.seg)
+        fwrite(r, sizeof(*r), 1, events.seg);
+}
+
+// Caller holds log_lock
+static void events_commit(int sync) {
+    if (!events.seg)
+        return;
+    fflush(events.seg);
+    if (sync)
+        fsync(fileno(events.seg));
+}
+
+// Caller holds log_lock; seals the current segment
+static void events_close(void) {
+    if (events.seg) {
+        fclose(events.seg);
+        events.seg = NULL;
+        events_seal(events.dir, events.day);
+    }
+    events.dir[0] = '\0';
+    events.day = -1;
+}
+
+typedef struct {
+    int event;             // LogEvent, or -1 for any
+    int ward;              // WardId, or -1 for any
+    EventKeyKind key_kind; // EVENTS_KEY_COUNT: any patient
+    uint64_t key;
+    int64_t since, until;  // Inclusive, in seconds since the epoch
+    unsigned long limit;   // Stop after this many matches, 0: no limit
+} EventQuery;
+
+typedef struct {
+    unsigned long matches;
+    int segments;         // Segments opened
+    int indexed;          // ... of which answered from their index
+    unsigned long scanned; // Records read outside an index
+    int truncated;        // Stopped at the limit
+} EventQueryStats;
+
+typedef void (*EventSink)(const EventRecord* r, void* arg);
+
+static int events_match(const EventQuery* q, const EventRecord* r) {
+    return (q->event < 0 || r->event == q->event)
+        && (q->ward < 0 || r->ward == q->ward)
+        && (q->key_kind == EVENTS_KEY_COUNT || events_record_key(r, q->key_kind) == q->key)
+        && r->time >= q->since && r->time <= q->until;
+}
+
+// First entry not below (event, key)
+static size_t events_lower_bound(const EventIndexEntry* e, size_t n, uint32_t event, uint64_t key) {
+    size_t lo = 0, hi = n;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (e[mid].event < event || (e[mid].event == event && e[mid].key < key))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static int events_cmp_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Candidate record numbers for q from a sealed index, in record order.
+// Returns how many (into *out, which the caller frees), or -1 if the index
+// is unusable and the covered records must be scanned instead.
+static long events_index_candidates(const void* idx, size_t len, const EventQuery* q, size_t nrec,
+                                    uint32_t** out, size_t* covered) {
+    const EventIndexHeader* h = idx;
+    if (!idx || len < sizeof(*h) || h->magic != EVENTS_IDX_MAGIC || h->version != EVENTS_IDX_VERSION)
+        return -1;
+    size_t total = 0;
+    for (int k = 0; k < EVENTS_KEY_COUNT; ++k)
+        total += h->entries[k];
+    if (len < sizeof(*h) + total * sizeof(EventIndexEntry) || h->records > nrec)
+        return -1;
+    *covered = h->records;
+    // The id index lists every record, so it also serves event-only queries
+    int kind = q->key_kind == EVENTS_KEY_COUNT ? EVENTS_KEY_ID : q->key_kind;
+    const EventIndexEntry* e = (const EventIndexEntry*)(h + 1);
+    for (int k = 0; k < kind; ++k)
+        e += h->entries[k];
+    size_t n = h->entries[kind];
+    size_t cap = 64, count = 0;
+    uint32_t* recs = malloc(sizeof(uint32_t) * cap);
+    if (!recs)
+        return -1;
+    int ev_lo = q->event < 0 ? 0 : q->event, ev_hi = q->event < 0 ? LOG_EV_COUNT - 1 : q->event;
+    for (int ev = ev_lo; ev <= ev_hi; ++ev) {
+        size_t i = q->key_kind == EVENTS_KEY_COUNT ? events_lower_bound(e, n, (uint32_t)ev, 0)
+                                                   : events_lower_bound(e, n, (uint32_t)ev, q->key);
+        for (; i < n && e[i].event == (uint32_t)ev && (q->key_kind == EVENTS_KEY_COUNT || e[i].key == q->key); ++i) {
+            if (count == cap) {
+                uint32_t* grown = realloc(recs, sizeof(uint32_t) * cap * 2);
+                if (!grown) {
+                    free(recs);
+                    return -1;
+                }
+                recs = grown;
+                cap *= 2;
+            }
+            recs[count++] = e[i].rec;
+        }
+    }
+    qsort(recs, count, sizeof(uint32_t), events_cmp_u32);
+    *out = recs;
+    return (long)count;
+}
+
+static int events_cmp_i64(const void* a, const void* b) {
+    int64_t x = *(const int64_t*)a, y = *(const int64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Days that have a segment in dir, oldest first; returns the count or -1
+static long events_list_days(const char* dir, int64_t** out) {
+    DIR* d = opendir(dir);
+    if (!d)
+        return -1;
+    size_t cap = 64, n = 0;
+    int64_t* days = malloc(sizeof(int64_t) * cap);
+    struct dirent* de;
+    while (days && (de = readdir(d))) {
+        struct tm tm = { 0 };
+        char ext[8];
+        if (sscanf(de->d_name, "%4d-%2d-%2d.%7s", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, ext) != 4
+            || strcmp(ext, "seg") != 0)
+            continue;
+        tm.tm_year -= 1900;
+        tm.tm_mon -= 1;
+        if (n == cap) {
+            int64_t* grown = realloc(days, sizeof(int64_t) * cap * 2);
+            if (!grown)
+                break;
+            days = grown;
+            cap *= 2;
+        }
+        days[n++] = (int64_t)timegm(&tm) / EVENTS_DAY_SECS;
+    }
+    closedir(d);
+    if (!days)
+        return -1;
+    qsort(days, n, sizeof(int64_t), events_cmp_i64);
+    *out = days;
+    return (long)n;
+}
+
+// Run q over the store in dir, calling sink for each match in time order
+// (per segment, in append order). Safe while the logger is writing.
+int events_query(const char* dir, const EventQuery* q, EventSink sink, void* arg, EventQueryStats* st) {
+    memset(st, 0, sizeof(*st));
+    int64_t* days;
+    long ndays = events_list_days(dir, &days);
+    if (ndays < 0) {
+        fprintf(stderr, "[ERROR] Cannot read event store %s: %s\n", dir, strerror(errno));
+        return -1;
+    }
+    // A record lands in the segment of the day it was written, which can
+    // trail its timestamp across midnight, so look one day further back
+    int64_t first = q->since / EVENTS_DAY_SECS - 1, last = q->until / EVENTS_DAY_SECS;
+    for (long d = 0; d < ndays && !st->truncated; ++d) {
+        if (days[d] < first || days[d] > last)
+            continue;
+        char path[512];
+        size_t seg_len, idx_len;
+        events_path(dir, days[d], "seg", path, sizeof(path));
+        const EventRecord* recs = events_map(path, &seg_len);
+        size_t nrec = seg_len / sizeof(EventRecord); // A torn tail record is ignored
+        events_path(dir, days[d], "idx", path, sizeof(path));
+        void* idx = events_map(path, &idx_len);
+        st->segments++;
+        uint32_t* cand = NULL;
+        size_t covered = 0;
+        long ncand = events_index_candidates(idx, idx_len, q, nrec, &cand, &covered);
+        if (ncand >= 0) {
+            st->indexed++;
+            for (long i = 0; i < ncand && !st->truncated; ++i) {
+                if (!events_match(q, &recs[cand[i]]))
+                    continue;
+                sink(&recs[cand[i]], arg);
+                st->truncated = (++st->matches == q->limit);
+            }
+            free(cand);
+        } else {
+            covered = 0;
+        }
+        for (size_t i = covered; i < nrec && !st->truncated; ++i) {
+            st->scanned++;
+            if (!events_match(q, &recs[i]))
+                continue;
+            sink(&recs[i], arg);
+            st->truncated = (++st->matches == q->limit);
+        }
+        if (idx)
+            munmap(idx, idx_len);
+        if (recs)
+            munmap((void*)recs, seg_len);
+    }
+    free(days);
+    return 0;
+}
+
+// "2026-03-01" (start of that UTC day) or "30d" (now minus 30 days)
+static int events_parse_time(const char* s, int64_t* out) {
+    int y, m, d;
+    char tail;
+    if (sscanf(s, "%d-%d-%d%c", &y, &m, &d, &tail) == 3) {
+        struct tm tm = { .tm_year = y - 1900, .tm_mon = m - 1, .tm_mday = d };
+        *out = (int64_t)timegm(&tm);
+        return 0;
+    }
+    char* end;
+    long n = strtol(s, &end, 10);
+    if (end != s && (*end == 'd' || *end == 'h') && end[1] == '\0' && n >= 0) {
+        *out = (int64_t)time(NULL) - n * (*end == 'd' ? EVENTS_DAY_SECS : 3600);
+        return 0;
+    }
+    return -1;
+}
+
+// Parse space-separated key=value terms:
+//   patient=<id> mrn=<n> name=<name> event=<checkin|admitted|discharged|transferred>
+//   ward=<ward> since=<YYYY-MM-DD|Nd|Nh> until=<...> limit=<n>
+// Returns 0, or -1 on an unknown or malformed term.
+int events_parse_query(const char* text, EventQuery* q) {
+    *q = (EventQuery){ .event = -1, .ward = -1, .key_kind = EVENTS_KEY_COUNT, .since = INT64_MIN / 2,
+                       .until = INT64_MAX / 2 };
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", text);
+    char* save;
+    for (char* tok = strtok_r(buf, " \t\r\n", &save); tok; tok = strtok_r(NULL, " \t\r\n", &save)) {
+        char* val = strchr(tok, '=');
+        if (!val || !val[1])
+            return -1;
+        *val++ = '\0';
+        char* end;
+        if (strcasecmp(tok, "patient") == 0) {
+            q->key_kind = EVENTS_KEY_ID;
+            q->key = strtoull(val, &end, 10);
+            if (*end)
+                return -1;
+        } else if (strcasecmp(tok, "mrn") == 0) {
+            q->key_kind = EVENTS_KEY_MRN;
+            q->key = strtoull(val, &end, 10);
+            if (*end || q->key == 0)
+                return -1;
+        } else if (strcasecmp(tok, "name") == 0) {
+            q->key_kind = EVENTS_KEY_NAME;
+            q->key = events_name_key(val);
+        } else if (strcasecmp(tok, "event") == 0) {
+            q->event = -1;
+            for (int e = 0; e < LOG_EV_COUNT; ++e) {
+                const char* n = log_event_names[e];
+                if (strcasecmp(val, n) == 0 || (e == LOG_EV_CHECKIN && strcasecmp(val, "checkin") == 0))
+                    q->event = e;
+            }
+            if (q->event < 0)
+                return -1;
+        } else if (strcasecmp(tok, "ward") == 0) {
+            q->ward = ward_parse(val);
+            if (q->ward == WARD_COUNT)
+                return -1;
+        } else if (strcasecmp(tok, "since") == 0) {
+            if (events_parse_time(val, &q->since) < 0)
+                return -1;
+        } else if (strcasecmp(tok, "until") == 0) {
+            // A bare date means through the end of that day
+            if (events_parse_time(val, &q->until) < 0)
+                return -1;
+            if (strchr(val, '-'))
+                q->until += EVENTS_DAY_SECS - 1;
+        } else if (strcasecmp(tok, "limit") == 0) {
+            q->limit = strtoul(val, &end, 10);
+            if (*end)
+                return -1;
+        } else {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// One audit line: time, event, patient, ward and bed
+void events_format(const EventRecord* r, char* out, size_t len) {
+    time_t t = (time_t)r->time;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    int n = snprintf(out, len, "%04d-%02d-%02d %02d:%02d:%02d %-11s patient=%d",
+                     tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
+                     r->event < LOG_EV_COUNT ? log_event_names[r->event] : "?", r->patient_id);
+    if (n >= 0 && (size_t)n < len && r->mrn)
+        n += snprintf(out + n, len - n, " mrn=%llu", (unsigned long long)r->mrn);
+    if (n >= 0 && (size_t)n < len)
+        n += snprintf(out + n, len - n, " type=%s severity=%d",
+                      r->patient_type < PATIENT_TYPE_COUNT ? patient_type_names[r->patient_type] : "?", r->severity);
+    if (n >= 0 && (size_t)n < len && r->ward < WARD_COUNT)
+        snprintf(out + n, len - n, " ward=%s bed=%d", ward_names[r->ward], r->bed);
+}
+
+static void events_print(const EventRecord* r, void* arg) {
+    char line[256];
+    events_format(r, line, sizeof(line));
+    fprintf(arg, "%s\n", line);
+}
+
+// Run a textual query against dir and print matches plus a summary to out
+int events_audit(const char* dir, const char* text, FILE* out) {
+    EventQuery q;
+    if (events_parse_query(text, &q) < 0) {
+        fprintf(stderr, "[ERROR] Bad audit query '%s'\n", text);
+        return -1;
+    }
+    EventQueryStats st;
+    uint64_t t0 = now_ns();
+    if (events_query(dir, &q, events_print, out, &st) < 0)
+        return -1;
+    fprintf(out, "[AUDIT] %lu events%s from %d segments (%d indexed, %lu records scanned) in %.3f ms\n",
+            st.matches, st.truncated ? " (limit reached)" : "", st.segments, st.indexed, st.scanned,
+            (double)(now_ns() - t0) / 1e6);
+    return 0;
+}
+
+// ------------- LOGGER -------------
+// Two modes: synchronous (format + flush under log_lock in the caller) and
+// asynchronous, where callers drop fixed-size records into a lock-free MPSC
+// ring and a writer thread formats them and group-commits to disk.
+typedef enum { LOG_DURABILITY_NONE, LOG_DURABILITY_FLUSH, LOG_DURABILITY_FSYNC } LogDurability;
+
+typedef struct {
+    int async;
+    size_t ring_capacity;   // Rounded up to a power of two
+    int flush_interval_ms;  // Writer wakeup / commit cadence when idle
+    int batch_size;         // Records written per group commit
+    LogDurability durability;
+} LoggerConfig;
+
+#define LOGGER_DEFAULT_CONFIG { 0, 4096, 20, 256, LOG_DURABILITY_FLUSH }
+
+typedef enum { LOG_REC_EVENT, LOG_REC_BED_STATUS } LogRecordKind;
+
+typedef struct {
+    LogRecordKind kind;
+    LogEvent event;
+    int has_patient;
+    int patient_id;
+    IdentityHandle ident; // Name is resolved by whoever writes the line
+    PatientType type;
+    int severity;
+    int ward;             // WardId, WARD_COUNT: none
+    int bed;
+    time_t time;          // Check-in time
+    time_t at;            // When the event happened
+    int total_beds;
+    int occupied_beds;
+} LogRecord;
+
+typedef struct {
+    atomic_size_t seq; // Slot turn counter (bounded MPMC ring, used here as MPSC)
+    LogRecord rec;
+} LogSlot;
+
+static FILE* log_file = NULL;
+static pthread_mutex_t log_lock;
+static LockStats log_lock_stats;
+static LoggerConfig log_cfg = LOGGER_DEFAULT_CONFIG;
+static LogSlot* log_ring = NULL;
+static size_t log_ring_mask = 0;
+static _Alignas(CACHE_LINE) atomic_size_t log_enqueue_pos; // Producers and the writer use separate lines
+static _Alignas(CACHE_LINE) size_t log_dequeue_pos; // Owned by the writer thread
+static atomic_int log_writer_running;
+static atomic_ulong log_ring_overflows; // Records written inline because the ring was full
+static pthread_t log_writer_thread;
+
+// Caller holds log_lock
+static void logger_write_record(const LogRecord* r) {
+    if (!log_file)
+        return;
+    if (r->kind == LOG_REC_BED_STATUS)
+        fprintf(log_file, "Bed Status: %d/%d beds occupied\n", r->occupied_beds, r->total_beds);
+    else if (!r->has_patient)
+        fprintf(log_file, "%s: (no patient)\n", log_event_names[r->event]);
+    else if (r->ward < WARD_COUNT)
+        fprintf(log_file, "%s: PatientID=%d, Name=%s, Type=%d, Time=%ld, Ward=%s, Bed=%d\n", log_event_names[r->event],
+                r->patient_id, identity_name(r->ident), r->type, r->time, ward_names[r->ward], r->bed);
+    else
+        fprintf(log_file, "%s: PatientID=%d, Name=%s, Type=%d, Time=%ld\n", log_event_names[r->event], r->patient_id,
+                identity_name(r->ident), r->type, r->time);
+    if (r->kind == LOG_REC_EVENT && r->has_patient && events.dir[0]) {
+        const Identity* id = identity_get(r->ident);
+        EventRecord e = {
+            .time = r->at, .mrn = id ? id->mrn : 0, .name_key = events_name_key(identity_name(r->ident)),
+            .patient_id = r->patient_id, .bed = (int16_t)(r->ward < WARD_COUNT ? r->bed : -1),
+            .event = (uint8_t)r->event, .ward = (uint8_t)r->ward, .patient_type = (uint8_t)r->type,
+            .severity = (uint8_t)r->severity,
+        };
+        events_append(&e);
+    }
+}
+
+// Caller holds log_lock
+static void logger_commit(void) {
+    if (!log_file || log_cfg.durability == LOG_DURABILITY_NONE)
+        return;
+    fflush(log_file);
+    if (log_cfg.durability == LOG_DURABILITY_FSYNC)
+        fsync(fileno(log_file));
+    events_commit(log_cfg.durability == LOG_DURABILITY_FSYNC);
+}
+
+static int logger_ring_push(const LogRecord* r) {
+    size_t pos = atomic_load_explicit(&log_enqueue_pos, memory_order_relaxed);
+    for (;;) {
+        LogSlot* slot = &log_ring[pos & log_ring_mask];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&log_enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                slot->rec = *r;
+                atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+                return 0;
+            }
+        } else if (diff < 0) {
+            return -1; // Full
+        } else {
+            pos = atomic_load_explicit(&log_enqueue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+// Writer thread only
+static int logger_ring_pop(LogRecord* out) {
+    LogSlot* slot = &log_ring[log_dequeue_pos & log_ring_mask];
+    size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    if (seq != log_dequeue_pos + 1)
+        return 0;
+    *out = slot->rec;
+    atomic_store_explicit(&slot->seq, log_dequeue_pos + log_ring_mask + 1, memory_order_release);
+    log_dequeue_pos++;
+    return 1;
+}
+
+// Drain up to one batch and commit it; returns the number of records written
+static int logger_drain_batch(void) {
+    LogRecord r;
+    int n = 0;
+    lock_timed(&log_lock, &log_lock_stats);
+    while (n < log_cfg.batch_size && logger_ring_pop(&r)) {
+        logger_write_record(&r);
+        n++;
+    }
+    if (n > 0)
+        logger_commit();
+    unlock_timed(&log_lock, &log_lock_stats);
+    return n;
+}
+
+static void* logger_writer(void* arg) {
+    struct timespec idle = { log_cfg.flush_interval_ms / 1000, (log_cfg.flush_interval_ms % 1000) * 1000000L };
+    while (atomic_load(&log_writer_running)) {
+        if (logger_drain_batch() == 0)
+            nanosleep(&idle, NULL);
+    }
+    while (logger_drain_batch() > 0)
+        ;
+    return NULL;
+}
+
+static void logger_submit(const LogRecord* r) {
+    if (log_ring && logger_ring_push(r) == 0)
+        return;
+    // Sync mode, or the ring is full: write inline rather than lose the record
+    if (log_ring)
+        atomic_fetch_add(&log_ring_overflows, 1);
+    lock_timed(&log_lock, &log_lock_stats);
+    logger_write_record(r);
+    logger_commit();
+    unlock_timed(&log_lock, &log_lock_stats);
+}
+
+void logger_init_config(const char* filename, const LoggerConfig* cfg) {
+    pthread_mutex_init(&log_lock, NULL);
+    lock_stats_init(&log_lock_stats, MET_LOG_LOCK_WAIT, MET_LOG_LOCK_HOLD);
+    if (cfg)
+        log_cfg = *cfg;
+    log_file = fopen(filename, "a");
+    if (!log_file || !log_cfg.async)
+        return;
+    size_t cap = 2;
+    while (cap < log_cfg.ring_capacity)
+        cap <<= 1;
+    if (log_cfg.batch_size <= 0)
+        log_cfg.batch_size = 1;
+    log_ring = malloc(sizeof(LogSlot) * cap);
+    if (!log_ring)
+        return; // Fall back to synchronous logging
+    for (size_t i = 0; i < cap; ++i)
+        atomic_init(&log_ring[i].seq, i);
+    log_ring_mask = cap - 1;
+    atomic_init(&log_enqueue_pos, 0);
+    log_dequeue_pos = 0;
+    atomic_init(&log_writer_running, 1);
+    if (pthread_create(&log_writer_thread, NULL, logger_writer, NULL) != 0) {
+        free(log_ring);
+        log_ring = NULL;
+        return;
+    }
+    affinity_pin_role(log_writer_thread, ROLE_LOGGER);
+}
+
+void logger_init(const char* filename) {
+    logger_init_config(filename, NULL);
+}
+
+static void logger_fill_event(LogRecord* r, LogEvent event, const Patient* patient, int ward, int bed, time_t at) {
+    r->kind = LOG_REC_EVENT;
+    r->event = event;
+    r->has_patient = (patient != NULL);
+    r->ward = ward;
+    r->bed = bed;
+    r->at = at;
+    if (patient) {
+        r->patient_id = patient->id;
+        r->ident = patient->ident;
+        r->type = patient->type;
+        r->severity = patient->severity;
+        r->time = patient->check_in_time;
+    }
+}
+
+// ward is WARD_COUNT (and bed ignored) for events that involve no bed
+void logger_log_event(LogEvent event, const Patient* patient, int ward, int bed) {
+    LogRecord r;
+    logger_fill_event(&r, event, patient, ward, bed, time(NULL));
+    logger_submit(&r);
+}
+
+// Same event for many patients: one log_lock round trip and one commit in
+// sync mode. beds may be NULL when ward is WARD_COUNT.
+void logger_log_events(LogEvent event, Patient* const* patients, int n, int ward, const int* beds) {
+    LogRecord r;
+    time_t at = time(NULL);
+    if (log_ring) {
+        for (int i = 0; i < n; ++i) {
+            logger_fill_event(&r, event, patients[i], ward, beds ? beds[i] : -1, at);
+            logger_submit(&r);
+        }
+        return;
+    }
+    lock_timed(&log_lock, &log_lock_stats);
+    for (int i = 0; i < n; ++i) {
+        logger_fill_event(&r, event, patients[i], ward, beds ? beds[i] : -1, at);
+        logger_write_record(&r);
+    }
+    logger_commit();
+    unlock_timed(&log_lock, &log_lock_stats);
+}
+
+void logger_log_bed_status(int total_beds, int occupied_beds) {
+    LogRecord r;
+    r.kind = LOG_REC_BED_STATUS;
+    r.total_beds = total_beds;
+    r.occupied_beds = occupied_beds;
+    logger_submit(&r);
+}
+
+void logger_close() {
+    if (log_ring) {
+        atomic_store(&log_writer_running, 0);
+        pthread_join(log_writer_thread, NULL);
+        free(log_ring);
+        log_ring = NULL;
+    }
+    pthread_mutex_lock(&log_lock);
+    if (log_file) {
+        fflush(log_file);
+        if (log_cfg.durability == LOG_DURABILITY_FSYNC)
+            fsync(fileno(log_file));
+        fclose(log_file);
+        log_file = NULL;
+    }
+    events_close();
+    pthread_mutex_unlock(&log_lock);
+}
+// ------------- CONSOLE -------------
+// Event output from the admission, discharge, allocation, network and
+// status threads. Callers format into a stack buffer and drop the line into
+// a lock-free MPSC ring; one writer thread drains it to stdout at most once
+// per flush interval, so a slow terminal never stalls bed allocation. A
+// full ring drops the line (and counts it) rather than block. In quiet
+// mode console_printf returns before formatting anything.
+// Threads marked console_direct (the interactive loop) drain the ring and
+// print inline, so prompts and command replies stay in order.
+#define CONSOLE_LINE_MAX 256
+#define CONSOLE_RING_SLOTS 1024 // Must be a power of two
+#define CONSOLE_DEFAULT_FLUSH_MS 50
+
+typedef struct {
+    atomic_size_t seq;
+    int len;
+    char text[CONSOLE_LINE_MAX];
+} ConsoleSlot;
+
+static int console_quiet;
+static _Thread_local int console_direct;
+static int console_flush_ms = CONSOLE_DEFAULT_FLUSH_MS;
+static ConsoleSlot* console_ring = NULL;
+static _Alignas(CACHE_LINE) atomic_size_t console_enqueue_pos;
+static _Alignas(CACHE_LINE) atomic_size_t console_written; // Writer's dequeue position, published after each batch
+static atomic_int console_running;
+static atomic_ulong console_dropped;
+static pthread_t console_thread;
+
+static int console_ring_push(const char* text, int len) {
+    size_t pos = atomic_load_explicit(&console_enqueue_pos, memory_order_relaxed);
+    for (;;) {
+        ConsoleSlot* slot = &console_ring[pos & (CONSOLE_RING_SLOTS - 1)];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&console_enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                memcpy(slot->text, text, len);
+                slot->len = len;
+                atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+                return 0;
+            }
+        } else if (diff < 0) {
+            return -1; // Full
+        } else {
+            pos = atomic_load_explicit(&console_enqueue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+// Writer thread only: write every ready line under one stdout lock
+static size_t console_drain(void) {
+    size_t pos = atomic_load_explicit(&console_written, memory_order_relaxed);
+    size_t n = 0;
+    flockfile(stdout);
+    for (;;) {
+        ConsoleSlot* slot = &console_ring[pos & (CONSOLE_RING_SLOTS - 1)];
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != pos + 1)
+            break;
+        fwrite_unlocked(slot->text, 1, slot->len, stdout);
+        atomic_store_explicit(&slot->seq, pos + CONSOLE_RING_SLOTS, memory_order_release);
+        pos++;
+        n++;
+    }
+    static unsigned long reported;
+    unsigned long dropped = atomic_load(&console_dropped);
+    if (dropped != reported) {
+        fprintf(stdout, COLOR_RED "[CONSOLE] %lu lines dropped\n" COLOR_RESET, dropped - reported);
+        reported = dropped;
+    }
+    if (n)
+        fflush_unlocked(stdout);
+    funlockfile(stdout);
+    atomic_store_explicit(&console_written, pos, memory_order_release);
+    return n;
+}
+
+static void* console_writer(void* arg) {
+    struct timespec idle = { console_flush_ms / 1000, (console_flush_ms % 1000) * 1000000L };
+    while (atomic_load(&console_running)) {
+        console_drain();
+        nanosleep(&idle, NULL);
+    }
+    while (console_drain() > 0)
+        ;
+    return NULL;
+}
+
+// Start the writer thread; without it console_printf prints inline
+void console_init(void) {
+    if (console_quiet)
+        return;
+    console_ring = malloc(sizeof(ConsoleSlot) * CONSOLE_RING_SLOTS);
+    if (!console_ring)
+        return;
+    for (size_t i = 0; i < CONSOLE_RING_SLOTS; ++i)
+        atomic_init(&console_ring[i].seq, i);
+    atomic_init(&console_enqueue_pos, 0);
+    atomic_init(&console_written, 0);
+    atomic_init(&console_running, 1);
+    if (pthread_create(&console_thread, NULL, console_writer, NULL) != 0) {
+        free(console_ring);
+        console_ring = NULL;
+        return;
+    }
+    affinity_pin_role(console_thread, ROLE_CONSOLE);
+}
+
+// Wait until every line queued so far has reached stdout
+void console_flush(void) {
+    if (console_ring) {
+        size_t target = atomic_load(&console_enqueue_pos);
+        struct timespec tick = { 0, 1000000L };
+        while (atomic_load(&console_written) < target && atomic_load(&console_running))
+            nanosleep(&tick, NULL);
+    }
+    fflush(stdout);
+}
+
+void console_close(void) {
+    if (!console_ring)
+        return;
+    atomic_store(&console_running, 0);
+    pthread_join(console_thread, NULL);
+    free(console_ring);
+    console_ring = NULL;
+}
+
+__attribute__((format(printf, 1, 2)))
+void console_printf(const char* fmt, ...) {
+    va_list ap;
+    if (console_direct || !console_ring) {
+        if (console_quiet && !console_direct)
+            return;
+        if (console_direct)
+            console_flush();
+        va_start(ap, fmt);
+        vprintf(fmt, ap);
+        va_end(ap);
+        return;
+    }
+    char line[CONSOLE_LINE_MAX];
+    va_start(ap, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    if (n < 0)
+        return;
+    if (n >= (int)sizeof(line))
+        n = sizeof(line) - 1;
+    if (console_ring_push(line, n) < 0)
+        atomic_fetch_add(&console_dropped, 1);
+}
+
+// ------------- JOURNAL -------------
+// Append-only binary journal of queue/bed events, written through a shared
+// mapping. A snapshot rewrites the file as the live queue plus occupancy, so
+// replay on startup only walks the records since the last compaction.
+#define JOURNAL_MAGIC   0x4A505348u // "HSPJ"
+#define JOURNAL_VERSION 3 // v3 added mrn; v2 journals are replayed and rewritten
+
+typedef enum { JREC_CHECKIN = 1, JREC_ADMITTED, JREC_DISCHARGED, JREC_BEDS } JournalRecType;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t used; // Bytes of committed records after the header
+} JournalHeader;
+
+typedef struct {
+    uint32_t type;
+    int32_t patient_id;
+    int32_t patient_type;
+    int32_t severity;
+    int32_t age;
+    int32_t isICU;
+    int32_t ward;
+    int32_t bed;          // Bed held (JREC_ADMITTED/DISCHARGED/BEDS)
+    int64_t check_in_time;
+    uint64_t seq;
+    char name[IDENT_NAME_MAX];
+    uint64_t mrn;         // New in v3; must stay last
+} JournalRecord;
+
+#define JOURNAL_V2_RECORD_SIZE offsetof(JournalRecord, mrn)
+
+typedef struct {
+    int fd;
+    char* base;
+    size_t capacity;
+    size_t since_snapshot;
+    char path[256];
+    pthread_mutex_t lock;
+} Journal;
+
+static JournalHeader* journal_header(Journal* j) {
+    return (JournalHeader*)j->base;
+}
+
+static int journal_map(Journal* j, const char* path, int truncate) {
+    int fd = open(path, O_RDWR | O_CREAT | (truncate ? O_TRUNC : 0), 0644);
+    if (fd < 0)
+        return -1;
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return -1;
+    }
+    size_t cap = (size_t)st.st_size;
+    if (cap < JOURNAL_INITIAL_SIZE) {
+        cap = JOURNAL_INITIAL_SIZE;
+        if (ftruncate(fd, (off_t)cap) < 0) {
+            close(fd);
+            return -1;
+        }
+    }
+    char* base = mmap(NULL, cap, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+    j->fd = fd;
+    j->base = base;
+    j->capacity = cap;
+    JournalHeader* h = journal_header(j);
+    if (h->magic != JOURNAL_MAGIC || (h->version != JOURNAL_VERSION && h->version != 2)
+        || h->used > cap - sizeof(JournalHeader)) {
+        if (h->magic != 0)
+            fprintf(stderr, "[WARN] %s is not a valid journal, starting empty\n", path);
+        h->magic = JOURNAL_MAGIC;
+        h->version = JOURNAL_VERSION;
+        h->used = 0;
+    }
+    return 0;
+}
+
+static void journal_unmap(Journal* j) {
+    if (j->fd < 0)
+        return;
+    msync(j->base, j->capacity, MS_SYNC);
+    munmap(j->base, j->capacity);
+    close(j->fd);
+    j->fd = -1;
+    j->base = NULL;
+}
+
+// Caller holds j->lock
+static int journal_reserve(Journal* j, size_t bytes) {
+    size_t needed = sizeof(JournalHeader) + journal_header(j)->used + bytes;
+    if (needed <= j->capacity)
+        return 0;
+    size_t cap = j->capacity * 2;
+    while (cap < needed)
+        cap *= 2;
+    if (ftruncate(j->fd, (off_t)cap) < 0)
+        return -1;
+    char* base = mmap(NULL, cap, PROT_READ | PROT_WRITE, MAP_SHARED, j->fd, 0);
+    if (base == MAP_FAILED)
+        return -1;
+    munmap(j->base, j->capacity);
+    j->base = base;
+    j->capacity = cap;
+    return 0;
+}
+
+// Caller holds j->lock. The record is copied before 'used' moves past it,
+// so a crash mid-append leaves only a torn tail that replay ignores.
+static void journal_append_locked(Journal* j, JournalRecType type, const Patient* p, int patient_id, int bed) {
+    if (j->fd < 0 || journal_reserve(j, sizeof(JournalRecord)) < 0)
+        return;
+    JournalHeader* h = journal_header(j);
+    JournalRecord* r = (JournalRecord*)(j->base + sizeof(JournalHeader) + h->used);
+    memset(r, 0, sizeof(*r));
+    r->type = type;
+    r->patient_id = patient_id;
+    r->ward = WARD_ADMISSION;
+    r->bed = bed;
+    if (p) {
+        r->patient_id = p->id;
+        r->patient_type = p->type;
+        r->severity = p->severity;
+        r->age = p->age;
+        r->isICU = p->isICU;
+        r->check_in_time = p->check_in_time;
+        r->seq = p->seq;
+        Identity* id = identity_get(p->ident);
+        if (id) {
+            strncpy(r->name, id->name, sizeof(r->name) - 1);
+            r->mrn = id->mrn;
+        }
+    }
+    atomic_thread_fence(memory_order_release);
+    h->used += sizeof(JournalRecord);
+    j->since_snapshot++;
+}
+
+void journal_append(Journal* j, JournalRecType type, const Patient* p, int patient_id, int bed) {
+    if (j->fd < 0)
+        return;
+    pthread_mutex_lock(&j->lock);
+    journal_append_locked(j, type, p, patient_id, bed);
+    pthread_mutex_unlock(&j->lock);
+}
+
+// One record per patient, all under a single journal lock acquisition
+void journal_append_batch(Journal* j, JournalRecType type, Patient* const* ps, const int* beds, int n) {
+    if (j->fd < 0 || n == 0)
+        return;
+    pthread_mutex_lock(&j->lock);
+    for (int i = 0; i < n; ++i)
+        journal_append_locked(j, type, ps[i], ps[i]->id, beds[i]);
+    pthread_mutex_unlock(&j->lock);
+}
+
+// Compact the journal to the current queue and admission-ward occupancy.
+// Caller holds bed_lock so no admission or discharge can interleave;
+// check-ins are excluded by the journal lock, which add_patient holds across
+// its submit, and pending arrivals are drained into the queue first.
+void journal_snapshot(Journal* j, PriorityQueue* pq, Ward* w, OccupantIndex* idx) {
+    if (j->fd < 0)
+        return;
+    pthread_mutex_lock(&j->lock);
+    Journal fresh = { .fd = -1 };
+    char tmp[sizeof(j->path) + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", j->path);
+    if (journal_map(&fresh, tmp, 1) == 0) {
+        pthread_mutex_lock(&w->lock);
+        pthread_mutex_lock(&idx->lock);
+        for (int bed = 0; bed < w->capacity; ++bed) {
+            if (!w->occupant[bed])
+                continue;
+            OccupantEntry* e = occ_probe(idx, w->occupant[bed]);
+            Patient* held = (e->patient_id == w->occupant[bed]) ? e->patient : NULL;
+            journal_append_locked(&fresh, JREC_BEDS, held, w->occupant[bed], bed);
+        }
+        pthread_mutex_unlock(&idx->lock);
+        pthread_mutex_unlock(&w->lock);
+        pthread_mutex_lock(&pq->lock);
+        pq_drain_locked(pq);
+        for (int l = 0; l < PQ_LEVELS; ++l)
+            for (int i = 0; i < pq->levels[l].count; ++i) {
+                Patient* qp = pq_level_at(&pq->levels[l], i);
+                journal_append_locked(&fresh, JREC_CHECKIN, qp, qp->id, -1);
+            }
+        pthread_mutex_unlock(&pq->lock);
+        msync(fresh.base, fresh.capacity, MS_SYNC);
+        if (rename(tmp, j->path) == 0) {
+            journal_unmap(j);
+            j->fd = fresh.fd;
+            j->base = fresh.base;
+            j->capacity = fresh.capacity;
+        } else {
+            journal_unmap(&fresh);
+            unlink(tmp);
+        }
+    }
+    j->since_snapshot = 0;
+    pthread_mutex_unlock(&j->lock);
+}
+
+// Compaction copies the live queue, so wait until the tail outgrows it too;
+// that keeps snapshot cost amortised O(1) per appended record
+void journal_maybe_snapshot(Journal* j, PriorityQueue* pq, Ward* w, OccupantIndex* idx) {
+    if (j->fd >= 0 && j->since_snapshot >= JOURNAL_SNAPSHOT_EVERY
+        && j->since_snapshot >= (size_t)pq_size(pq))
+        journal_snapshot(j, pq, w, idx);
+}
+
+// Replay tracks pending check-ins with compact keys, so probing by id and
+// sorting a large backlog never walk the Patient records themselves
+typedef struct {
+    unsigned long seq;
+    Patient* patient; // NULL once the check-in has been admitted
+} JournalPendingKey;
+
+typedef struct {
+    int patient_id;   // 0: empty
+    uint32_t pending; // Index into the pending keys
+} JournalIdSlot;
+
+static int journal_seq_cmp(const void* a, const void* b) {
+    const JournalPendingKey* ka = a;
+    const JournalPendingKey* kb = b;
+    return (ka->seq > kb->seq) - (ka->seq < kb->seq);
+}
+
+static Patient* journal_record_to_patient(const JournalRecord* r, uint64_t mrn) {
+    Patient* p = patient_alloc();
+    if (!p)
+        return NULL;
+    p->id = r->patient_id;
+    char name[IDENT_NAME_MAX];
+    memcpy(name, r->name, sizeof(name));
+    name[sizeof(name)-1] = '\0';
+    p->ident = identity_intern(name, mrn);
+    p->age = r->age;
+    p->type = (PatientType)r->patient_type;
+    p->severity = r->severity;
+    p->isICU = r->isICU;
+    p->check_in_time = (time_t)r->check_in_time;
+    p->seq = r->seq;
+    return p;
+}
+
+// Open (or create) the journal and rebuild the queue, bed occupancy and the
+// occupant index from it.
+// Returns the highest patient id seen so new check-ins do not reuse ids.
+int journal_open_and_replay(Journal* j, const char* path, PriorityQueue* pq, Ward* w, OccupantIndex* idx) {
+    pthread_mutex_init(&j->lock, NULL);
+    strncpy(j->path, path, sizeof(j->path)-1);
+    j->path[sizeof(j->path)-1] = '\0';
+    if (journal_map(j, j->path, 0) < 0) {
+        fprintf(stderr, "[WARN] Could not open journal %s: %s\n", path, strerror(errno));
+        return 0;
+    }
+    JournalHeader* h = journal_header(j);
+    int upgrade = (h->version != JOURNAL_VERSION);
+    size_t rec_size = upgrade ? JOURNAL_V2_RECORD_SIZE : sizeof(JournalRecord);
+    size_t count = h->used / rec_size;
+    const char* recs = j->base + sizeof(JournalHeader);
+
+    // Open-addressed id -> slot table over the pending (not yet admitted) check-ins
+    size_t table_cap = 16;
+    while (table_cap < count * 2)
+        table_cap <<= 1;
+    JournalIdSlot* table = calloc(table_cap, sizeof(JournalIdSlot));
+    JournalPendingKey* pending = malloc(sizeof(JournalPendingKey) * (count ? count : 1));
+    Patient** beds = calloc(w->capacity ? w->capacity : 1, sizeof(Patient*));
+    if (!table || !pending || !beds) {
+        free(table);
+        free(pending);
+        free(beds);
+        return 0;
+    }
+    int max_id = 0;
+    size_t npending = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const JournalRecord* r = (const JournalRecord*)(recs + i * rec_size);
+        uint64_t mrn = upgrade ? 0 : r->mrn;
+        size_t slot = ((uint32_t)r->patient_id * 2654435761u) & (table_cap - 1);
+        while (table[slot].patient_id && table[slot].patient_id != r->patient_id)
+            slot = (slot + 1) & (table_cap - 1);
+        JournalPendingKey* known = table[slot].patient_id ? &pending[table[slot].pending] : NULL;
+        // Every record type counts: a snapshot of an empty queue holds only bed holders
+        if (r->patient_id > max_id)
+            max_id = r->patient_id;
+        switch (r->type) {
+        case JREC_BEDS:
+            if (r->bed >= 0 && r->bed < w->capacity && !beds[r->bed])
+                beds[r->bed] = journal_record_to_patient(r, mrn);
+            break;
+        case JREC_CHECKIN:
+            if (known)
+                break;
+            Patient* p = journal_record_to_patient(r, mrn);
+            if (!p)
+                break;
+            table[slot].patient_id = r->patient_id;
+            table[slot].pending = (uint32_t)npending;
+            pending[npending].seq = r->seq;
+            pending[npending++].patient = p;
+            break;
+        case JREC_ADMITTED:
+            if (known && known->patient) {
+                // The slot stays as a tombstone and keeps the probe chain intact
+                patient_free(known->patient);
+                known->patient = NULL;
+            }
+            if (r->bed >= 0 && r->bed < w->capacity) {
+                patient_free(beds[r->bed]);
+                beds[r->bed] = journal_record_to_patient(r, mrn);
+            }
+            break;
+        case JREC_DISCHARGED:
+            if (r->bed >= 0 && r->bed < w->capacity) {
+                patient_free(beds[r->bed]);
+                beds[r->bed] = NULL;
+            }
+            break;
+        }
+    }
+    qsort(pending, npending, sizeof(JournalPendingKey), journal_seq_cmp);
+    int restored = 0;
+    for (size_t i = 0; i < npending; ++i) {
+        if (!pending[i].patient)
+            continue;
+        if (pq_push(pq, pending[i].patient) < 0) {
+            patient_free(pending[i].patient);
+            continue;
+        }
+        identity_visit(pending[i].patient);
+        restored++;
+    }
+    for (int bed = 0; bed < w->capacity; ++bed) {
+        if (!beds[bed])
+            continue;
+        if (ward_claim(w, bed, beds[bed]->id) < 0
+            || occ_insert(idx, beds[bed]->id, WARD_ADMISSION, bed, beds[bed]) < 0)
+            patient_free(beds[bed]);
+        else
+            identity_visit(beds[bed]);
+    }
+    free(table);
+    free(pending);
+    free(beds);
+    if (count > 0)
+        console_printf(COLOR_BOLD COLOR_GREEN "[INFO] Journal replayed %zu records: %d queued, %d beds occupied\n" COLOR_RESET,
+               count, restored, ward_occupied(w));
+    if (upgrade) // Rewrite in the current format before anything is appended
+        journal_snapshot(j, pq, w, idx);
+    return max_id;
+}
+
+void journal_close(Journal* j) {
+    pthread_mutex_lock(&j->lock);
+    journal_unmap(j);
+    pthread_mutex_unlock(&j->lock);
+}
+
+// ------------- GLOBALS ------------
+// Optional observer, called under the shard's bed_lock right after each admission
+static void (*admit_hook)(struct Hospital* h, Patient* p, int bed) = NULL;
+static _Alignas(CACHE_LINE) atomic_int next_patient_id = 1; // Shared by all shards, so ids are unique process-wide
+
+// For graceful shutdown
+volatile sig_atomic_t running = 1;
+
+// ------------- STATUS SNAPSHOT -------------
+// Seqlock-published view of occupancy and queue depth, one board per shard.
+// Writers (admit, discharge, check-in, ward allocation) call status_publish
+// after changing state; status_read never blocks and never touches bed_lock
+// or pq.lock.
+typedef struct {
+    int occupied[WARD_COUNT];
+    int capacity[WARD_COUNT];
+    int queued;
+    unsigned long admitted;   // Admission-ward admissions since start
+    unsigned long discharged; // Admission-ward discharges since start
+    int forecast_free[WARD_COUNT][FORECAST_HORIZONS]; // Free beds expected by each horizon
+    time_t updated;
+    unsigned version;         // Even; bumps by 2 per publish
+} HospitalStatus;
+
+typedef struct {
+    _Alignas(CACHE_LINE) atomic_uint seq;
+    pthread_mutex_t write_lock; // Orders publishers against each other only
+    atomic_int occupied[WARD_COUNT];
+    atomic_int capacity[WARD_COUNT];
+    atomic_int queued;
+    atomic_ulong admitted;
+    atomic_ulong discharged;
+    atomic_int forecast_free[WARD_COUNT][FORECAST_HORIZONS];
+    atomic_long updated;
+} StatusBoard;
+
+// ------------- HOSPITAL SHARDS -------------
+// One process can host several independent hospitals. Each shard owns its
+// queue, wards, occupant index, journal, status board, locks and threads,
+// so shards never contend with each other. Patient ids, the log and the
+// metrics are process-wide. A full shard's EMERGENCY patients may be
+// borrowed by a neighbour with a free admission bed (see hospital_borrow).
+#define MAX_HOSPITALS 64
+
+// Shards are cache-line aligned, and the fields written on every check-in,
+// admission or discharge sit on lines of their own
+typedef struct Hospital {
+    _Alignas(CACHE_LINE) int index;
+    char name[32];
+    PriorityQueue pq;
+    Ward wards[WARD_COUNT];
+    OccupantIndex occupants;
+    Journal journal;
+    _Alignas(CACHE_LINE) pthread_mutex_t bed_lock; // Serialises admission/discharge of the admission ward
+    LockStats bed_lock_stats;
+    pthread_cond_t admit_cond; // Signalled under bed_lock on check-in and discharge
+    _Alignas(CACHE_LINE) atomic_int admit_idle; // Admission thread is waiting, or about to, on admit_cond
+    WorkerPool pool;           // Runs ICU/General bed allocations
+    TimerWheel wheel;          // Expected discharges of everyone holding a bed
+    StatusBoard status;
+    CensusLog census;          // Versioned bed/queue change feed (SUBSCRIBE)
+    _Alignas(CACHE_LINE) atomic_ulong admitted_total;
+    atomic_ulong discharged_total;
+    atomic_ulong borrowed_total; // EMERGENCY patients taken from other shards
+    int cpu;                     // Default core for the shard's threads, or -1
+    pthread_t admit_thread;
+    pthread_t discharge_thread;
+} Hospital;
+
+static Hospital hospitals[MAX_HOSPITALS];
+static int hospital_count = 1;
+
+// Shard k > 0 journals to "<path>.<k>" so shard 0 keeps the classic file
+static void hospital_journal_path(const Hospital* h, const char* base, char* out, size_t len) {
+    if (h->index == 0)
+        snprintf(out, len, "%s", base);
+    else
+        snprintf(out, len, "%s.%d", base, h->index);
+}
+
+// Pin one of the shard's threads to its role's CPU for this shard
+static void hospital_pin_thread(const Hospital* h, ThreadRole role, pthread_t t) {
+    affinity_pin_cpu(t, affinity_shard_cpu(role, h->index, h->cpu), thread_role_names[role]);
+}
+
+// Set up shard state; admission_beds sizes the admission ward and the
+// others come from the ward layout.
+// With journal_path set the shard is replayed from its journal.
+// Returns the highest patient id seen in the journal (0 without one).
+int hospital_init(Hospital* h, int index, int admission_beds, const char* journal_path) {
+    memset(h, 0, sizeof(*h));
+    h->index = index;
+    snprintf(h->name, sizeof(h->name), "Hospital-%d", index);
+    h->cpu = -1;
+    pthread_mutex_init(&h->bed_lock, NULL);
+    lock_stats_init(&h->bed_lock_stats, MET_BED_LOCK_WAIT, MET_BED_LOCK_HOLD);
+    pthread_cond_init(&h->admit_cond, NULL);
+    pq_init(&h->pq);
+    for (int i = 0; i < WARD_COUNT; ++i)
+        ward_init(&h->wards[i], ward_names[i], i == WARD_ADMISSION ? admission_beds : ward_beds[i]);
+    occ_init(&h->occupants);
+    wheel_init(&h->wheel);
+    census_init(&h->census);
+    h->occupants.wheel = &h->wheel; // Journal replay arms restored occupants from now
+    h->occupants.census = &h->census;
+    h->journal.fd = -1;
+    atomic_init(&h->status.seq, 0);
+    pthread_mutex_init(&h->status.write_lock, NULL);
+    if (!journal_path) {
+        pthread_mutex_init(&h->journal.lock, NULL);
+        return 0;
+    }
+    char path[sizeof(h->journal.path)];
+    hospital_journal_path(h, journal_path, path, sizeof(path));
+    return journal_open_and_replay(&h->journal, path, &h->pq, &h->wards[WARD_ADMISSION], &h->occupants);
+}
+
+typedef struct {
+    Hospital* h;
+    int index;
+    int admission_beds;
+    const char* journal_path;
+    int max_id;
+} HospitalInitJob;
+
+static void* hospital_init_job(void* arg) {
+    HospitalInitJob* job = arg;
+    job->max_id = hospital_init(job->h, job->index, job->admission_beds, job->journal_path);
+    return NULL;
+}
+
+// hospital_init on a thread bound to the shard's admission CPU, so the
+// pages the shard's threads work on land on that CPU's NUMA node; cpu is
+// the shard's default core (or -1). Runs inline when there is no CPU to use.
+int hospital_init_local(Hospital* h, int index, int admission_beds, const char* journal_path, int cpu) {
+    int local = affinity_shard_cpu(ROLE_ADMIT, index, cpu);
+    HospitalInitJob job = { h, index, admission_beds, journal_path, 0 };
+    pthread_attr_t attr;
+    pthread_t t;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (local >= 0)
+        CPU_SET(local, &set);
+    if (local < 0 || pthread_attr_init(&attr) != 0) {
+        hospital_init_job(&job);
+    } else {
+        if (pthread_attr_setaffinity_np(&attr, sizeof(set), &set) != 0
+            || pthread_create(&t, &attr, hospital_init_job, &job) != 0)
+            hospital_init_job(&job);
+        else
+            pthread_join(t, NULL);
+        pthread_attr_destroy(&attr);
+    }
+    h->cpu = cpu;
+    if (local >= 0)
+        console_printf("[INFO] %s: admit CPU %d, discharge CPU %d, workers CPU %d, memory on NUMA node %d\n", h->name,
+                       local, affinity_shard_cpu(ROLE_DISCHARGE, index, cpu), affinity_shard_cpu(ROLE_WORKERS, index, cpu),
+                       cpu_numa_node(local));
+    return job.max_id;
+}
+
+// Call once the shard's threads and pool have stopped
+void hospital_destroy(Hospital* h) {
+    journal_close(&h->journal);
+    census_destroy(&h->census);
+    occ_destroy(&h->occupants);
+    pq_destroy(&h->pq);
+    for (int i = 0; i < WARD_COUNT; i++)
+        ward_destroy(&h->wards[i]);
+}
+
+// Shard with the given index, or NULL if out of range
+Hospital* hospital_at(int index) {
+    return (index >= 0 && index < hospital_count) ? &hospitals[index] : NULL;
+}
+
+// Shard currently holding patient_id in a bed, with its index entry
+static Hospital* hospital_find_occupant(int patient_id, OccupantEntry* out) {
+    for (int i = 0; i < hospital_count; ++i)
+        if (occ_lookup(&hospitals[i].occupants, patient_id, out) == 0)
+            return &hospitals[i];
+    return NULL;
+}
+
+// Look up "#<mrn>" or an exact name; 0 if unknown
+IdentityHandle identity_lookup(const char* key) {
+    if (key[0] == '#')
+        return identity_find_mrn(strtoull(key + 1, NULL, 10));
+    return identity_find_name(key);
+}
+
+// One-line summary of an identity and where its latest visit is
+void identity_describe(IdentityHandle handle, char* out, size_t len) {
+    Identity* e = identity_get(handle);
+    if (!e) {
+        snprintf(out, len, "unknown");
+        return;
+    }
+    int id = atomic_load(&e->last_patient);
+    OccupantEntry occ;
+    Hospital* h = id ? hospital_find_occupant(id, &occ) : NULL;
+    int n = snprintf(out, len, "name=%s mrn=%llu visits=%u patient=%d ", e->name,
+                     (unsigned long long)e->mrn, atomic_load(&e->visits), id);
+    if (n < 0 || (size_t)n >= len)
+        return;
+    if (h)
+        snprintf(out + n, len - n, "hospital=%d ward=%s bed=%d", h->index, ward_names[occ.ward], occ.bed);
+    else
+        snprintf(out + n, len - n, "ward=none");
+}
+
+// ------------- STATUS PUBLISHING -------------
+void status_publish(Hospital* h) {
+    StatusBoard* b = &h->status;
+    int queued = pq_size(&h->pq);
+    metric_record(MET_QUEUE_DEPTH, (uint64_t)queued);
+    pthread_mutex_lock(&b->write_lock);
+    unsigned seq = atomic_load_explicit(&b->seq, memory_order_relaxed);
+    atomic_store_explicit(&b->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    for (int i = 0; i < WARD_COUNT; ++i) {
+        int occupied = ward_occupied(&h->wards[i]);
+        atomic_store_explicit(&b->occupied[i], occupied, memory_order_relaxed);
+        atomic_store_explicit(&b->capacity[i], h->wards[i].capacity, memory_order_relaxed);
+        for (int f = 0; f < FORECAST_HORIZONS; ++f) {
+            int due = atomic_load_explicit(&h->wheel.due_within[i][f], memory_order_relaxed);
+            int free_beds = h->wards[i].capacity - occupied + due;
+            atomic_store_explicit(&b->forecast_free[i][f], free_beds < h->wards[i].capacity ? free_beds : h->wards[i].capacity,
+                                  memory_order_relaxed);
+        }
+    }
+    atomic_store_explicit(&b->queued, queued, memory_order_relaxed);
+    atomic_store_explicit(&b->admitted, atomic_load(&h->admitted_total), memory_order_relaxed);
+    atomic_store_explicit(&b->discharged, atomic_load(&h->discharged_total), memory_order_relaxed);
+    atomic_store_explicit(&b->updated, (long)time(NULL), memory_order_relaxed);
+    atomic_store_explicit(&b->seq, seq + 2, memory_order_release);
+    pthread_mutex_unlock(&b->write_lock);
+}
+
+// Lock-free; retries only while a publish is in flight
+void status_read(Hospital* h, HospitalStatus* out) {
+    StatusBoard* b = &h->status;
+    unsigned before, after;
+    do {
+        before = atomic_load_explicit(&b->seq, memory_order_acquire);
+        if (before & 1)
+            continue;
+        for (int i = 0; i < WARD_COUNT; ++i) {
+            out->occupied[i] = atomic_load_explicit(&b->occupied[i], memory_order_relaxed);
+            out->capacity[i] = atomic_load_explicit(&b->capacity[i], memory_order_relaxed);
+            for (int f = 0; f < FORECAST_HORIZONS; ++f)
+                out->forecast_free[i][f] = atomic_load_explicit(&b->forecast_free[i][f], memory_order_relaxed);
+        }
+        out->queued = atomic_load_explicit(&b->queued, memory_order_relaxed);
+        out->admitted = atomic_load_explicit(&b->admitted, memory_order_relaxed);
+        out->discharged = atomic_load_explicit(&b->discharged, memory_order_relaxed);
+        out->updated = (time_t)atomic_load_explicit(&b->updated, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&b->seq, memory_order_relaxed);
+    } while ((before & 1) || before != after);
+    out->version = before;
+}
+
+// Utility: Print real-time status
+void print_status() {
+    HospitalStatus st;
+    for (int i = 0; i < hospital_count; ++i) {
+        status_read(&hospitals[i], &st);
+        if (hospital_count > 1)
+            console_printf(COLOR_BOLD COLOR_CYAN "\n[STATUS] %s  Beds Occupied: %d/%d  Borrowed: %lu\n" COLOR_RESET,
+                   hospitals[i].name, st.occupied[WARD_ADMISSION], st.capacity[WARD_ADMISSION],
+                   atomic_load(&hospitals[i].borrowed_total));
+        else
+            console_printf(COLOR_BOLD COLOR_CYAN "\n[STATUS] Beds Occupied: %d/%d\n" COLOR_RESET,
+                   st.occupied[WARD_ADMISSION], st.capacity[WARD_ADMISSION]);
+        char wards[CONSOLE_LINE_MAX];
+        int len = 0;
+        for (int w = WARD_ADMISSION + 1; w < WARD_COUNT && len < (int)sizeof(wards); ++w)
+            len += snprintf(wards + len, sizeof(wards) - len, "%s%s: %d/%d", w > WARD_ADMISSION + 1 ? "  " : "",
+                            ward_names[w], st.occupied[w], st.capacity[w]);
+        console_printf(COLOR_BOLD COLOR_CYAN "%s\n" COLOR_RESET, wards);
+        console_printf(COLOR_BOLD COLOR_YELLOW "Patients in Queue: %d\n" COLOR_RESET, st.queued);
+        char forecast[CONSOLE_LINE_MAX];
+        len = snprintf(forecast, sizeof(forecast), "Expected free beds (");
+        for (int f = 0; f < FORECAST_HORIZONS; ++f)
+            len += snprintf(forecast + len, sizeof(forecast) - len, "%s%s", f ? "/" : "", forecast_horizon_names[f]);
+        len += snprintf(forecast + len, sizeof(forecast) - len, "):");
+        for (int w = 0; w < WARD_COUNT && len < (int)sizeof(forecast); ++w) {
+            len += snprintf(forecast + len, sizeof(forecast) - len, " %s ", ward_names[w]);
+            for (int f = 0; f < FORECAST_HORIZONS && len < (int)sizeof(forecast); ++f)
+                len += snprintf(forecast + len, sizeof(forecast) - len, "%s%d", f ? "/" : "", st.forecast_free[w][f]);
+        }
+        console_printf(COLOR_CYAN "%s\n" COLOR_RESET, forecast);
+    }
+}
+
+static void print_hist_line(const char* label, MetricHist h, int as_time) {
+    HistSnapshot hs;
+    metrics_read_hist(h, &hs);
+    if (as_time)
+        console_printf("  %-22s n=%-8lu p50=%.1fus p99=%.1fus max=%.1fus\n", label, (unsigned long)hs.count,
+               hist_percentile(&hs, 50.0) / 1000.0, hist_percentile(&hs, 99.0) / 1000.0, hs.max / 1000.0);
+    else
+        console_printf("  %-22s n=%-8lu p50=%lu p99=%lu max=%lu\n", label, (unsigned long)hs.count,
+               (unsigned long)hist_percentile(&hs, 50.0), (unsigned long)hist_percentile(&hs, 99.0),
+               (unsigned long)hs.max);
+}
+
+static unsigned long lock_contended_pct(LockStats* st, unsigned long* acq) {
+    *acq = atomic_load(&st->acquisitions);
+    return *acq ? atomic_load(&st->contended) * 100 / *acq : 0;
+}
+
+// Sum one LockStats field set over every shard's lock; which picks the lock
+static void hospital_lock_totals(int which, unsigned long* acq, unsigned long* contended) {
+    *acq = *contended = 0;
+    for (int i = 0; i < hospital_count; ++i) {
+        Hospital* h = &hospitals[i];
+        LockStats* a = (which == 0) ? &h->bed_lock_stats : &h->pq.push_stats;
+        LockStats* b = (which == 0) ? NULL : &h->pq.pop_stats;
+        *acq += atomic_load(&a->acquisitions) + (b ? atomic_load(&b->acquisitions) : 0);
+        *contended += atomic_load(&a->contended) + (b ? atomic_load(&b->contended) : 0);
+    }
+}
+
+// Extra section for the interactive 'status' command
+void print_metrics_summary(void) {
+    if (!metrics_enabled)
+        return;
+    unsigned long acq;
+    console_printf(COLOR_BOLD COLOR_CYAN "[METRICS]\n" COLOR_RESET);
+    print_hist_line("check-in -> admission", MET_ADMIT_LATENCY, 1);
+    print_hist_line("ICU bed wait", MET_ICU_BED_WAIT, 1);
+    print_hist_line("General bed wait", MET_GENERAL_BED_WAIT, 1);
+    print_hist_line("queue depth", MET_QUEUE_DEPTH, 0);
+    unsigned long contended;
+    hospital_lock_totals(0, &acq, &contended);
+    console_printf("  bed_lock  acquisitions=%lu contended=%lu%%\n", acq, acq ? contended * 100 / acq : 0);
+    print_hist_line("bed_lock wait", MET_BED_LOCK_WAIT, 1);
+    print_hist_line("bed_lock hold", MET_BED_LOCK_HOLD, 1);
+    hospital_lock_totals(1, &acq, &contended);
+    console_printf("  pq.lock   acquisitions=%lu contended=%lu%%\n", acq, acq ? contended * 100 / acq : 0);
+    print_hist_line("pq.lock wait", MET_PQ_LOCK_WAIT, 1);
+    print_hist_line("pq.lock hold", MET_PQ_LOCK_HOLD, 1);
+    unsigned long pct = lock_contended_pct(&log_lock_stats, &acq);
+    console_printf("  log_lock  acquisitions=%lu contended=%lu%%\n", acq, pct);
+    print_hist_line("log_lock wait", MET_LOG_LOCK_WAIT, 1);
+    print_hist_line("log_lock hold", MET_LOG_LOCK_HOLD, 1);
+}
+
+static void prometheus_lock(FILE* f, const char* hospital, const char* lock, LockStats* st) {
+    fprintf(f, "hospital_lock_acquisitions_total{hospital=\"%s\",lock=\"%s\"} %lu\n",
+            hospital, lock, atomic_load(&st->acquisitions));
+    fprintf(f, "hospital_lock_contended_total{hospital=\"%s\",lock=\"%s\"} %lu\n",
+            hospital, lock, atomic_load(&st->contended));
+}
+
+// Prometheus text exposition format; histograms are exported as summaries
+void metrics_write_prometheus(FILE* f) {
+    static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+    HospitalStatus st;
+    fprintf(f, "# TYPE hospital_queue_length gauge\n# TYPE hospital_beds_occupied gauge\n");
+    fprintf(f, "# TYPE hospital_borrowed_total counter\n");
+    for (int h = 0; h < hospital_count; ++h) {
+        Hospital* hp = &hospitals[h];
+        status_read(hp, &st);
+        fprintf(f, "hospital_queue_length{hospital=\"%s\"} %d\n", hp->name, st.queued);
+        for (int i = 0; i < WARD_COUNT; ++i)
+            fprintf(f, "hospital_beds_occupied{hospital=\"%s\",ward=\"%s\"} %d\n",
+                    hp->name, hp->wards[i].name, st.occupied[i]);
+        fprintf(f, "hospital_borrowed_total{hospital=\"%s\"} %lu\n", hp->name, atomic_load(&hp->borrowed_total));
+    }
+    for (int c = 0; c < MET_COUNTER_COUNT; ++c)
+        fprintf(f, "# TYPE %s counter\n%s %lu\n", metric_counter_names[c], metric_counter_names[c],
+                (unsigned long)metrics_counter((MetricCounter)c));
+    fprintf(f, "# TYPE hospital_lock_acquisitions_total counter\n# TYPE hospital_lock_contended_total counter\n");
+    for (int h = 0; h < hospital_count; ++h) {
+        Hospital* hp = &hospitals[h];
+        prometheus_lock(f, hp->name, "bed", &hp->bed_lock_stats);
+        prometheus_lock(f, hp->name, "queue_push", &hp->pq.push_stats);
+        prometheus_lock(f, hp->name, "queue_pop", &hp->pq.pop_stats);
+    }
+    prometheus_lock(f, "all", "log", &log_lock_stats);
+    HistSnapshot hs;
+    for (int h = MET_HIST_NONE + 1; h < MET_HIST_COUNT; ++h) {
+        const char* name = metric_hist_names[h];
+        double scale = strstr(name, "_seconds") ? 1e-9 : 1.0;
+        metrics_read_hist((MetricHist)h, &hs);
+        fprintf(f, "# TYPE %s summary\n", name);
+        for (size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); ++q)
+            fprintf(f, "%s{quantile=\"%g\"} %.9g\n", name, quantiles[q],
+                    hist_percentile(&hs, quantiles[q] * 100.0) * scale);
+        fprintf(f, "%s_sum %.9g\n%s_count %lu\n", name, hs.sum * scale, name, (unsigned long)hs.count);
+    }
+}
+
+// Rewrite path atomically so a scraper never reads a half-written file
+int metrics_write_file(const char* path) {
+    char tmp[512];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE* f = fopen(tmp, "w");
+    if (!f) {
+        fprintf(stderr, "[ERROR] Cannot write metrics to %s: %s\n", tmp, strerror(errno));
+        return -1;
+    }
+    metrics_write_prometheus(f);
+    if (fclose(f) != 0 || rename(tmp, path) != 0) {
+        fprintf(stderr, "[ERROR] Cannot write metrics to %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static const char* metrics_file; // Refreshed by the status monitor when set
+
+// ------------- CONTROL PLANE -------------
+// SIGINT and SIGTERM are blocked in every thread and read from a signalfd
+// by one control thread, so no code runs in signal context. A shutdown
+// request (a signal, 'exit', or the end of stdin) clears running, latches
+// an eventfd that sleeping threads poll, and interrupts the main thread's
+// blocking read. A second signal skips the orderly path and exits at once.
+#define CONTROL_WAKE_SIGNAL SIGUSR1 // Sent to the main thread only
+
+typedef struct {
+    int signal_fd;
+    int wake_fd;           // eventfd, readable from the first shutdown request on
+    pthread_t thread;
+    pthread_t main_thread;
+    int started;
+    atomic_int requested;
+    uint64_t requested_ns;
+} ControlPlane;
+
+static ControlPlane control = { .signal_fd = -1, .wake_fd = -1 };
+
+static void control_wake_handler(int sig) {
+    (void)sig; // Only here so blocking calls in the main thread return EINTR
+}
+
+void control_request_shutdown(const char* why) {
+    if (atomic_exchange(&control.requested, 1))
+        return;
+    control.requested_ns = now_ns();
+    running = 0;
+    console_printf(COLOR_BOLD COLOR_MAGENTA "\n[INFO] Shutting down hospital system (%s)...\n" COLOR_RESET, why);
+    if (control.wake_fd >= 0) {
+        uint64_t one = 1;
+        ssize_t rc = write(control.wake_fd, &one, sizeof(one));
+        (void)rc;
+    }
+    if (control.started && !pthread_equal(pthread_self(), control.main_thread))
+        pthread_kill(control.main_thread, CONTROL_WAKE_SIGNAL);
+}
+
+// Sleep up to ms milliseconds; returns 1 at once (and from then on) if
+// shutdown has been requested
+int control_wait_ms(int ms) {
+    struct pollfd pfd = { .fd = control.wake_fd, .events = POLLIN };
+    while (running) {
+        int rc = poll(&pfd, 1, ms); // A negative fd just sleeps
+        if (rc >= 0 || errno != EINTR)
+            break;
+    }
+    return !running;
+}
+
+static void* control_loop(void* arg) {
+    (void)arg;
+    struct signalfd_siginfo si;
+    while (read(control.signal_fd, &si, sizeof(si)) == (ssize_t)sizeof(si)) {
+        if (atomic_load(&control.requested)) {
+            static const char msg[] = "\n[INFO] Second signal, exiting without cleanup\n";
+            ssize_t rc = write(STDERR_FILENO, msg, sizeof(msg) - 1);
+            (void)rc;
+            _exit(128 + (int)si.ssi_signo);
+        }
+        control_request_shutdown(si.ssi_signo == SIGTERM ? "SIGTERM" : "SIGINT");
+    }
+    return NULL;
+}
+
+// Call from the main thread before any other thread exists, so every
+// thread inherits the blocked mask; returns 0 or -1
+int control_init(void) {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGTERM);
+    if (pthread_sigmask(SIG_BLOCK, &set, NULL) != 0)
+        return -1;
+    struct sigaction sa = { .sa_handler = control_wake_handler }; // No SA_RESTART
+    sigemptyset(&sa.sa_mask);
+    sigaction(CONTROL_WAKE_SIGNAL, &sa, NULL);
+    control.main_thread = pthread_self();
+    control.signal_fd = signalfd(-1, &set, SFD_CLOEXEC);
+    control.wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (control.signal_fd < 0 || control.wake_fd < 0
+        || pthread_create(&control.thread, NULL, control_loop, NULL) != 0) {
+        fprintf(stderr, "[ERROR] Cannot start control plane: %s\n", strerror(errno));
+        pthread_sigmask(SIG_UNBLOCK, &set, NULL);
+        return -1;
+    }
+    control.started = 1;
+    return 0;
+}
+
+// Milliseconds since the first shutdown request
+double control_shutdown_ms(void) {
+    return atomic_load(&control.requested) ? (double)(now_ns() - control.requested_ns) / 1e6 : 0.0;
+}
+
+void control_close(void) {
+    if (control.started) {
+        pthread_cancel(control.thread); // Parked in read(), a cancellation point
+        pthread_join(control.thread, NULL);
+        control.started = 0;
+    }
+    if (control.signal_fd >= 0)
+        close(control.signal_fd);
+    if (control.wake_fd >= 0)
+        close(control.wake_fd);
+    control.signal_fd = control.wake_fd = -1;
+}
+
+// Thread to periodically print status; a tick on which no shard's census
+// moved prints nothing, since the board would read the same as last time
+void* status_monitor(void* arg) {
+    uint64_t printed = 0;
+    while (running) {
+        uint64_t v = 0;
+        for (int i = 0; i < hospital_count; ++i)
+            v += census_version(&hospitals[i].census);
+        if (v != printed) {
+            print_status();
+            printed = v;
+        }
+        if (metrics_file)
+            metrics_write_file(metrics_file);
+        if (control_wait_ms(4000))
+            break;
+    }
+    return NULL;
+}
+// ------------- THREAD ROUTINES -------------
+// Wake a shard's admission thread after a check-in or a freed bed. While
+// it is busy it drains the arrival ring by itself, so only an idle thread
+// costs the caller bed_lock.
+void admission_notify(Hospital* h) {
+    atomic_thread_fence(memory_order_seq_cst); // Check-in before the flag; pairs with admit_patients
+    if (!atomic_load_explicit(&h->admit_idle, memory_order_relaxed))
+        return;
+    lock_timed(&h->bed_lock, &h->bed_lock_stats);
+    pthread_cond_signal(&h->admit_cond);
+    unlock_timed(&h->bed_lock, &h->bed_lock_stats);
+}
+
+#define ADMIT_BATCH 64 // Patients placed per queue/ward lock round trip
+
+// Core admission step shared by the admission thread and the simulator:
+// move up to max of the highest-priority queued patients into free beds of
+// w, popping the queue once and taking the ward lock once for the batch.
+// Returns how many were admitted; out[i] got beds[i]. The caller is the
+// ward's only admitter (bed_lock, or the single-threaded simulator), so
+// the free-bed count read here cannot shrink underneath it.
+int admit_batch(PriorityQueue* q, Ward* w, time_t now, Patient** out, int* beds, int max) {
+    int k = ward_free_beds(w);
+    if (k > max)
+        k = max;
+    if (k <= 0)
+        return 0;
+    int n = pq_pop_batch_at(q, out, k, now);
+    int got = ward_alloc_batch(w, out, beds, n);
+    for (int i = got; i < n; ++i)
+        pq_push(q, out[i]); // Cannot happen for the sole admitter, but never drop a patient
+    return got;
+}
+
+// Single-patient form used by the simulator. Returns the bed, or -1 if
+// there is no bed or no patient.
+int admit_next(PriorityQueue* q, Ward* w, time_t now, Patient** out) {
+    int bed;
+    return admit_batch(q, w, now, out, &bed, 1) ? bed : -1;
+}
+
+// A shard overflows when its admission ward is full and an EMERGENCY
+// patient is waiting; neighbours with a free bed may borrow that patient
+static int hospital_overflowing(Hospital* d) {
+    return ward_free_beds(&d->wards[WARD_ADMISSION]) == 0
+        && pq_top_level(&d->pq) >= PQ_LEVEL(EMERGENCY, 1);
+}
+
+static int hospital_any_overflowing(Hospital* h) {
+    for (int i = 0; i < hospital_count; ++i)
+        if (&hospitals[i] != h && hospital_overflowing(&hospitals[i]))
+            return 1;
+    return 0;
+}
+
+// Take one EMERGENCY patient from an overflowing neighbour, scanning from
+// the next shard round-robin. The donor journals the patient as having left
+// its queue (ADMITTED with no bed). Caller holds h->bed_lock; only leaf
+// locks of the donor (pq, journal) are taken, so shards cannot deadlock.
+static Patient* hospital_borrow(Hospital* h) {
+    for (int k = 1; k < hospital_count; ++k) {
+        Hospital* d = &hospitals[(h->index + k) % hospital_count];
+        if (!hospital_overflowing(d))
+            continue;
+        Patient* p = pq_pop_min_level(&d->pq, PQ_LEVEL(EMERGENCY, 1), time(NULL));
+        if (!p)
+            continue;
+        journal_append(&d->journal, JREC_ADMITTED, p, p->id, -1);
+        status_publish(d);
+        console_printf(COLOR_RED "[OVERFLOW] %s borrows EMERGENCY patient %s from %s\n" COLOR_RESET,
+               h->name, identity_name(p->ident), d->name);
+        atomic_fetch_add(&h->borrowed_total, 1);
+        return p;
+    }
+    return NULL;
+}
+
+// Next batch for the free beds of h: its own queue first, then one patient
+// of a neighbour's overflow. Returns how many were placed.
+static int hospital_admit_batch(Hospital* h, Patient** out, int* beds) {
+    Ward* w = &h->wards[WARD_ADMISSION];
+    int n = admit_batch(&h->pq, w, time(NULL), out, beds, ADMIT_BATCH);
+    if (n > 0 || hospital_count == 1 || ward_free_beds(w) == 0)
+        return n;
+    Patient* p = hospital_borrow(h);
+    if (!p)
+        return 0;
+    beds[0] = ward_try_alloc(w, p->id);
+    if (beds[0] < 0) {
+        pq_push(&h->pq, p); // Cannot happen under bed_lock, but never drop a patient
+        return 0;
+    }
+    out[0] = p;
+    return 1;
+}
+
+// Fill every free admission bed of h; caller holds h->bed_lock.
+// Admitted patients move into the occupant index, which owns them from here on.
+// Each batch takes the queue, ward, index, journal and log locks once.
+static void admit_ready_locked(Hospital* h) {
+    Ward* w = &h->wards[WARD_ADMISSION];
+    Patient* batch[ADMIT_BATCH];
+    int beds[ADMIT_BATCH];
+    int admitted = 0;
+    int n;
+    while ((n = hospital_admit_batch(h, batch, beds)) > 0) {
+        int tracked = occ_insert_batch(&h->occupants, WARD_ADMISSION, batch, beds, n);
+        for (int i = tracked; i < n; ++i) {
+            // No room to track the stay; give the bed back rather than lose the record
+            ward_release(w, beds[i]);
+            pq_push(&h->pq, batch[i]);
+        }
+        journal_append_batch(&h->journal, JREC_ADMITTED, batch, beds, tracked);
+        logger_log_events(LOG_EV_ADMITTED, batch, tracked, WARD_ADMISSION, beds);
+        logger_log_bed_status(w->capacity, ward_occupied(w));
+        uint64_t now = now_ns();
+        for (int i = 0; i < tracked; ++i) {
+            Patient* p = batch[i];
+            console_printf("Admitted: %s (%s) -> Bed %d\n", identity_name(p->ident), (p->type==EMERGENCY)?"EMERGENCY":"REGULAR", beds[i]);
+            metric_record(MET_ADMIT_LATENCY, now - p->check_in_ns);
+            if (admit_hook)
+                admit_hook(h, p, beds[i]); // May discharge p; nothing touches it after this
+        }
+        metric_count(MET_ADMISSIONS, tracked);
+        atomic_fetch_add(&h->admitted_total, tracked);
+        admitted += tracked;
+        if (tracked < n)
+            break;
+    }
+    if (admitted) {
+        status_publish(h);
+        journal_maybe_snapshot(&h->journal, &h->pq, w, &h->occupants);
+    }
+}
+
+static int admission_ready(Hospital* h) {
+    return ward_free_beds(&h->wards[WARD_ADMISSION]) > 0
+        && (!pq_is_empty(&h->pq) || hospital_any_overflowing(h));
+}
+
+// One per shard; arg is the Hospital. This is the queue's scheduler: every
+// pop drains the arrival ring, so check-ins reach the buckets in batches.
+void* admit_patients(void* arg) {
+    Hospital* h = arg;
+    lock_timed(&h->bed_lock, &h->bed_lock_stats);
+    while (running) {
+        if (admission_ready(h)) {
+            admit_ready_locked(h);
+            continue;
+        }
+        // Raise the flag before the last look: a check-in either lands in
+        // time for it or sees the flag and signals under bed_lock
+        atomic_store_explicit(&h->admit_idle, 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (running && !admission_ready(h)) {
+            lock_stats_release(&h->bed_lock_stats);
+            pthread_cond_wait(&h->admit_cond, &h->bed_lock);
+            lock_stats_acquired(&h->bed_lock_stats);
+        }
+        atomic_store_explicit(&h->admit_idle, 0, memory_order_relaxed);
+    }
+    unlock_timed(&h->bed_lock, &h->bed_lock_stats);
+    return NULL;
+}
+
+// Free an admission-ward bed held by e and hand it straight to the next
+// queued patient; caller holds h->bed_lock and has removed e from the index
+static void discharge_entry_locked(Hospital* h, const OccupantEntry* e) {
+    Ward* w = &h->wards[WARD_ADMISSION];
+    ward_release(w, e->bed);
+    journal_append(&h->journal, JREC_DISCHARGED, e->patient, e->patient_id, e->bed);
+    logger_log_event(LOG_EV_DISCHARGED, e->patient, WARD_ADMISSION, e->bed);
+    logger_log_bed_status(w->capacity, ward_occupied(w));
+    console_printf(COLOR_YELLOW "[DISCHARGE] Discharged patient %d from bed %d.\n" COLOR_RESET, e->patient_id, e->bed);
+    patient_free(e->patient);
+    metric_count(MET_DISCHARGES, 1);
+    atomic_fetch_add(&h->discharged_total, 1);
+    status_publish(h);
+    admit_ready_locked(h);
+}
+
+// Discharge a patient from (ward, bed) of shard h, if they still hold it.
+// Returns the bed freed, or -1 if they have left or moved since.
+static int discharge_patient_at(Hospital* h, int patient_id, int ward, int bed) {
+    OccupantEntry e;
+    Ward* w = &h->wards[ward];
+    if (ward == WARD_ADMISSION) {
+        lock_timed(&h->bed_lock, &h->bed_lock_stats);
+        int ok = occ_remove_at(&h->occupants, patient_id, ward, bed, &e) == 0;
+        if (ok)
+            discharge_entry_locked(h, &e);
+        unlock_timed(&h->bed_lock, &h->bed_lock_stats);
+        return ok ? e.bed : -1;
+    }
+    if (occ_remove_at(&h->occupants, patient_id, ward, bed, &e) < 0)
+        return -1;
+    ward_release(w, e.bed); // Hands the bed to the next parked request, if any
+    logger_log_event(LOG_EV_DISCHARGED, e.patient, e.ward, e.bed);
+    console_printf(COLOR_YELLOW "[DISCHARGE] Discharged patient %d from %s bed %d.\n" COLOR_RESET, patient_id, w->name, e.bed);
+    patient_free(e.patient);
+    metric_count(MET_DISCHARGES, 1);
+    status_publish(h);
+    return e.bed;
+}
+
+// Discharge a patient from whatever bed they hold, in whichever shard, in
+// O(1) per shard via the occupant index. Returns the bed freed, or -1 if
+// the patient holds no bed.
+int discharge_patient_id(int patient_id) {
+    OccupantEntry e;
+    Hospital* h = hospital_find_occupant(patient_id, &e);
+    return h ? discharge_patient_at(h, patient_id, e.ward, e.bed) : -1;
+}
+
+// Move a bed-holding patient to another ward of the same shard. The new bed
+// is taken first, so a full target ward leaves the patient where they are.
+// Returns the new bed, or -1 if the patient holds no bed or the target ward is full.
+int transfer_patient(int patient_id, WardId to) {
+    OccupantEntry e;
+    Hospital* h = hospital_find_occupant(patient_id, &e);
+    if (to < 0 || to >= WARD_COUNT || !h || e.ward == (int)to)
+        return -1;
+    Ward* dst = &h->wards[to];
+    Ward* src = &h->wards[e.ward];
+    int from_admission = (e.ward == WARD_ADMISSION);
+    // Admission beds are only ever taken under bed_lock (see admit_batch)
+    if (from_admission || to == WARD_ADMISSION)
+        lock_timed(&h->bed_lock, &h->bed_lock_stats);
+    int bed = ward_try_alloc(dst, patient_id);
+    Patient moved;
+    if (bed >= 0 && occ_move(&h->occupants, patient_id, e.ward, e.bed, to, bed, &moved) < 0) {
+        ward_release(dst, bed); // Discharged or moved while we were allocating
+        bed = -1;
+    } else if (bed >= 0) {
+        ward_release(src, e.bed);
+        if (from_admission)
+            journal_append(&h->journal, JREC_DISCHARGED, &moved, patient_id, e.bed);
+        if (to == WARD_ADMISSION)
+            journal_append(&h->journal, JREC_ADMITTED, &moved, patient_id, bed);
+        logger_log_event(LOG_EV_TRANSFERRED, &moved, to, bed);
+        metric_count(MET_TRANSFERS, 1);
+        console_printf(COLOR_YELLOW "[TRANSFER] Patient %d: %s bed %d -> %s bed %d\n" COLOR_RESET,
+               patient_id, src->name, e.bed, dst->name, bed);
+        if (from_admission)
+            admit_ready_locked(h);
+        status_publish(h);
+    }
+    if (from_admission || to == WARD_ADMISSION)
+        unlock_timed(&h->bed_lock, &h->bed_lock_stats);
+    return bed;
+}
+
+#define DISCHARGE_BATCH 256
+
+// One per shard; arg is the Hospital. Ticks the shard's timer wheel,
+// discharging each patient whose expected stay has run out, samples queue
+// depth and head into the census each tick, and refreshes the free-bed
+// forecast on the status board once a second.
+void* discharge_patients(void* arg) {
+    Hospital* h = arg;
+    TimerWheel* w = &h->wheel;
+    WheelExpiry due[DISCHARGE_BATCH];
+    uint64_t next_forecast = 0;
+    while (running) {
+        uint64_t tick = wheel_tick_at(w, now_ns());
+        int n;
+        do {
+            n = wheel_expire(w, tick, due, DISCHARGE_BATCH);
+            // Only from the bed the timer was armed for: a patient discharged
+            // by hand or transferred meanwhile (which re-arms) is left alone
+            for (int i = 0; i < n; ++i)
+                discharge_patient_at(h, due[i].patient_id, due[i].ward, due[i].bed);
+        } while (n == DISCHARGE_BATCH);
+        census_sample(&h->census, &h->pq);
+        if (tick >= next_forecast) {
+            wheel_forecast(w);
+            status_publish(h);
+            next_forecast = tick + 1000 / WHEEL_TICK_MS;
+        }
+        // Sleep to the next tick boundary, or until shutdown is requested
+        uint64_t wake = w->origin_ns + (tick + 1) * WHEEL_TICK_MS * 1000000ull;
+        uint64_t now = now_ns();
+        if (wake > now)
+            control_wait_ms((int)((wake - now + 999999) / 1000000));
+    }
+    return NULL;
+}
+
+// Bed allocation runs as a chain of pool tasks: start -> (parked) -> granted.
+// Once granted, the patient record belongs to the occupant index and the
+// shard's timer wheel discharges them when their expected stay runs out.
+
+static void allocate_bed_granted(Task* t) {
+    BedRequest* req = (BedRequest*)t;
+    Hospital* h = req->hospital;
+    Patient* p = req->patient;
+    metric_record(req->ward == &h->wards[WARD_ICU] ? MET_ICU_BED_WAIT : MET_GENERAL_BED_WAIT,
+                  now_ns() - req->requested_ns);
+    console_printf(COLOR_BOLD COLOR_MAGENTA "[%s ALLOCATED] Patient %d (Severity: %d) -> Bed %d\n" COLOR_RESET,
+           (p->type == ICU) ? "ICU" : "WARD", p->id, p->severity, req->bed);
+    int ward = (int)(req->ward - h->wards);
+    Patient admitted = *p; // p belongs to the index (and its discharge timer) once inserted
+    if (occ_insert(&h->occupants, p->id, ward, req->bed, p) < 0) {
+        WorkerPool* pool = t->pool;
+        ward_release(req->ward, req->bed);
+        patient_free(p);
+        free(req);
+        pool_job_end(pool);
+        return;
+    }
+    logger_log_event(LOG_EV_ADMITTED, &admitted, ward, req->bed);
+    status_publish(h);
+    WorkerPool* pool = t->pool;
+    free(req);
+    pool_job_end(pool);
+}
+
+static void allocate_bed_start(Task* t) {
+    BedRequest* req = (BedRequest*)t;
+    Patient* p = req->patient;
+    if (req->ward == &req->hospital->wards[WARD_ICU])
+        console_printf(COLOR_CYAN "[ICU REQUEST] Patient %d requires ICU\n" COLOR_RESET, p->id);
+    else
+        console_printf(COLOR_CYAN "[WARD REQUEST] Patient %d requires %s Ward\n" COLOR_RESET, p->id, req->ward->name);
+    t->fn = allocate_bed_granted;
+    req->bed = ward_alloc_or_park(req->ward, req);
+    if (req->bed >= 0)
+        allocate_bed_granted(t);
+    else
+        metric_count(MET_WARD_PARKED, 1);
+}
+
+// Queue an ICU/General allocation for p on the shard's pool; takes ownership of p
+int allocate_bed(Hospital* h, Patient* p) {
+    BedRequest* req = malloc(sizeof(BedRequest));
+    if (!req)
+        return -1;
+    req->task.fn = allocate_bed_start;
+    req->patient = p;
+    req->patient_id = p->id;
+    req->hospital = h;
+    req->ward = &h->wards[ward_for(p)];
+    req->bed = -1;
+    req->requested_ns = now_ns();
+    pool_job_begin(&h->pool);
+    pool_submit(&h->pool, &req->task);
+    return 0;
+}
+
+// Start a shard's worker pool, admission and discharge threads, pinned to
+// h->cpu when it is set
+int hospital_start(Hospital* h, int workers) {
+    if (pool_init(&h->pool, workers) < 0) {
+        fprintf(stderr, "[ERROR] Could not start worker pool for %s\n", h->name);
+        return -1;
+    }
+    wheel_forecast(&h->wheel);
+    status_publish(h);
+    pthread_create(&h->admit_thread, NULL, admit_patients, h);
+    pthread_create(&h->discharge_thread, NULL, discharge_patients, h);
+    hospital_pin_thread(h, ROLE_ADMIT, h->admit_thread);
+    hospital_pin_thread(h, ROLE_DISCHARGE, h->discharge_thread);
+    for (int i = 0; i < h->pool.nthreads; ++i)
+        hospital_pin_thread(h, ROLE_WORKERS, h->pool.threads[i]);
+    return 0;
+}
+
+// Join the shard's threads; call after running has been cleared
+void hospital_stop(Hospital* h) {
+    pthread_mutex_lock(&h->bed_lock);
+    pthread_cond_broadcast(&h->admit_cond);
+    pthread_mutex_unlock(&h->bed_lock);
+    pthread_join(h->admit_thread, NULL);
+    pthread_join(h->discharge_thread, NULL);
+    pool_shutdown(&h->pool);
+    journal_snapshot(&h->journal, &h->pq, &h->wards[WARD_ADMISSION], &h->occupants);
+}
+
+// ------------- PATIENT ARRIVAL SIMULATION -------------
+// Check a patient in at shard h.
+// Returns the new patient's id, or -1 if the check-in failed
+int add_patient(Hospital* h, const char* name, PatientType type, int severity, int isICU) {
+    Patient* p = patient_alloc();
+    if (!p) {
+        fprintf(stderr, "[ERROR] Out of memory, check-in for %s failed\n", name);
+        return -1;
+    }
+    p->id = atomic_fetch_add(&next_patient_id, 1);
+    p->ident = identity_intern(name, 0);
+    p->type = type;
+    p->check_in_time = time(NULL);
+    p->check_in_ns = now_ns();
+    p->severity = severity;
+    p->isICU = isICU;
+    // Once submitted, p belongs to the admission thread and may be admitted,
+    // discharged and freed at any moment, so everything after reads a copy
+    Patient arrival = *p;
+    // Submit and journal under the journal lock so a snapshot sees both or
+    // neither; without a journal the check-in takes no lock at all
+    int journaled = (h->journal.fd >= 0);
+    if (journaled)
+        pthread_mutex_lock(&h->journal.lock);
+    int pushed = pq_submit(&h->pq, p);
+    if (pushed == 0 && journaled)
+        journal_append_locked(&h->journal, JREC_CHECKIN, &arrival, arrival.id, -1);
+    if (journaled)
+        pthread_mutex_unlock(&h->journal.lock);
+    if (pushed < 0) {
+        fprintf(stderr, "[ERROR] Queue full, check-in for %s failed\n", name);
+        patient_free(p);
+        return -1;
+    }
+    identity_visit(&arrival);
+    int overflow = (type == EMERGENCY && ward_free_beds(&h->wards[WARD_ADMISSION]) == 0);
+    logger_log_event(LOG_EV_CHECKIN, &arrival, WARD_COUNT, -1);
+    status_publish(h);
+    admission_notify(h);
+    // A full shard lets its neighbours' admission threads borrow the patient
+    for (int i = 0; overflow && i < hospital_count; ++i)
+        if (&hospitals[i] != h)
+            admission_notify(&hospitals[i]);
+    return arrival.id;
+}
+
+// ------------- BULK INGESTION -------------
+// Batch check-in path for historical intake files: patients are parsed from
+// an mmap'd file in LOAD_BATCH chunks and each chunk is queued, journaled and
+// logged with one lock acquisition per stage instead of one per patient.
+// Two input formats are accepted:
+//   CSV:    name,type,severity,isICU[,check_in_time[,mrn]]  ('#' comments, optional header)
+//           check_in_time may be left empty when only the MRN is given
+//           type is REGULAR/EMERGENCY/GENERAL/ICU or 0-3
+//   Binary: IntakeFileHeader followed by IntakeRecord[count]
+#define LOAD_BATCH 4096
+#define INTAKE_MAGIC 0x42505348u // "HSPB"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t count;
+} IntakeFileHeader;
+
+typedef struct {
+    char name[64];
+    int32_t type;
+    int32_t severity;
+    int32_t isICU;
+    int32_t age;
+    int64_t check_in_time; // 0: use load time
+} IntakeRecord;
+
+#define BULK_CHUNK 64 // Patients copied and submitted per journal lock round trip
+
+// Check in pre-built patients. Ids are assigned here; a zero check_in_time
+// means "now". Returns the number accepted; rejected patients are freed.
+// As in add_patient, a submitted patient may already be gone, so each chunk
+// is copied first and journaled and logged from the copies.
+int add_patients_bulk(Hospital* h, Patient** patients, int n) {
+    if (n <= 0)
+        return 0;
+    time_t now = time(NULL);
+    uint64_t now_mono = now_ns();
+    int first_id = atomic_fetch_add(&next_patient_id, n);
+    for (int i = 0; i < n; ++i) {
+        patients[i]->id = first_id + i;
+        if (patients[i]->check_in_time == 0)
+            patients[i]->check_in_time = now;
+        patients[i]->check_in_ns = now_mono;
+    }
+    Patient arrivals[BULK_CHUNK];
+    Patient* logged[BULK_CHUNK];
+    int pushed = 0;
+    while (pushed < n) {
+        int k = n - pushed < BULK_CHUNK ? n - pushed : BULK_CHUNK;
+        for (int i = 0; i < k; ++i) {
+            arrivals[i] = *patients[pushed + i];
+            logged[i] = &arrivals[i];
+        }
+        pthread_mutex_lock(&h->journal.lock);
+        int accepted = pq_submit_batch(&h->pq, patients + pushed, k);
+        for (int i = 0; i < accepted; ++i)
+            journal_append_locked(&h->journal, JREC_CHECKIN, &arrivals[i], arrivals[i].id, -1);
+        pthread_mutex_unlock(&h->journal.lock);
+        for (int i = 0; i < accepted; ++i)
+            identity_visit(&arrivals[i]);
+        logger_log_events(LOG_EV_CHECKIN, logged, accepted, WARD_COUNT, NULL);
+        pushed += accepted;
+        if (accepted < k)
+            break;
+    }
+    for (int i = pushed; i < n; ++i)
+        patient_free(patients[i]);
+    if (pushed < n)
+        fprintf(stderr, "[ERROR] Queue full, %d bulk check-ins failed\n", n - pushed);
+    status_publish(h);
+    admission_notify(h);
+    return pushed;
+}
+
+static int intake_parse_type(const char* s, size_t len, PatientType* out) {
+    static const char* names[] = { "REGULAR", "EMERGENCY", "GENERAL", "ICU" };
+    if (len == 1 && s[0] >= '0' && s[0] <= '3') {
+        *out = (PatientType)(s[0] - '0');
+        return 0;
+    }
+    for (int t = REGULAR; t <= ICU; ++t) {
+        if (strlen(names[t]) == len && strncasecmp(s, names[t], len) == 0) {
+            *out = (PatientType)t;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Split one CSV line into at most max fields (no quoting)
+static int intake_split(const char* line, const char* end, const char** f, size_t* flen, int max) {
+    int n = 0;
+    const char* start = line;
+    for (const char* c = line; ; ++c) {
+        if (c == end || *c == ',') {
+            if (n < max) {
+                while (start < c && (*start == ' ' || *start == '\t'))
+                    start++;
+                const char* stop = c;
+                while (stop > start && (stop[-1] == ' ' || stop[-1] == '\t' || stop[-1] == '\r'))
+                    stop--;
+                f[n] = start;
+                flen[n] = (size_t)(stop - start);
+                n++;
+            }
+            if (c == end)
+                break;
+            start = c + 1;
+        }
+    }
+    return n;
+}
+
+static long intake_field_long(const char* s, size_t len, int* ok) {
+    char buf[32];
+    if (len == 0 || len >= sizeof(buf)) {
+        *ok = 0;
+        return 0;
+    }
+    memcpy(buf, s, len);
+    buf[len] = '\0';
+    char* endp;
+    long v = strtol(buf, &endp, 10);
+    if (*endp != '\0')
+        *ok = 0;
+    return v;
+}
+
+static long load_csv(Hospital* h, const char* data, size_t size, long* skipped) {
+    Patient* batch[LOAD_BATCH];
+    int nbatch = 0;
+    long loaded = 0;
+    const char* end = data + size;
+    for (const char* line = data; line < end; ) {
+        const char* eol = memchr(line, '\n', (size_t)(end - line));
+        if (!eol)
+            eol = end;
+        const char* f[6];
+        size_t flen[6];
+        int nf = intake_split(line, eol, f, flen, 6);
+        int blank = (nf == 1 && flen[0] == 0);
+        int header = (nf >= 1 && flen[0] == 4 && strncasecmp(f[0], "name", 4) == 0);
+        if (!blank && !header && !(flen[0] > 0 && f[0][0] == '#')) {
+            PatientType type;
+            int ok = (nf >= 4 && flen[0] > 0 && intake_parse_type(f[1], flen[1], &type) == 0);
+            long sev = ok ? intake_field_long(f[2], flen[2], &ok) : 0;
+            long icu = ok ? intake_field_long(f[3], flen[3], &ok) : 0;
+            long when = (ok && nf >= 5 && flen[4]) ? intake_field_long(f[4], flen[4], &ok) : 0;
+            long mrn = (ok && nf == 6) ? intake_field_long(f[5], flen[5], &ok) : 0;
+            Patient* p = (ok && mrn >= 0) ? patient_alloc() : NULL;
+            if (p) {
+                char name[IDENT_NAME_MAX];
+                size_t n = flen[0] < sizeof(name) - 1 ? flen[0] : sizeof(name) - 1;
+                memcpy(name, f[0], n);
+                name[n] = '\0';
+                p->ident = identity_intern(name, (uint64_t)mrn);
+                p->type = type;
+                p->severity = (int)sev;
+                p->isICU = icu != 0;
+                p->check_in_time = (time_t)when;
+                batch[nbatch++] = p;
+                if (nbatch == LOAD_BATCH) {
+                    loaded += add_patients_bulk(h, batch, nbatch);
+                    nbatch = 0;
+                }
+            } else {
+                (*skipped)++;
+            }
+        }
+        line = eol + 1;
+    }
+    loaded += add_patients_bulk(h, batch, nbatch);
+    return loaded;
+}
+
+static long load_binary(Hospital* h, const char* data, size_t size, long* skipped) {
+    const IntakeFileHeader* hdr = (const IntakeFileHeader*)data;
+    uint64_t avail = (size - sizeof(*hdr)) / sizeof(IntakeRecord);
+    uint64_t count = hdr->count < avail ? hdr->count : avail;
+    if (count < hdr->count)
+        *skipped += (long)(hdr->count - count); // Truncated file
+    const IntakeRecord* recs = (const IntakeRecord*)(data + sizeof(*hdr));
+    Patient* batch[LOAD_BATCH];
+    int nbatch = 0;
+    long loaded = 0;
+    for (uint64_t i = 0; i < count; ++i) {
+        const IntakeRecord* r = &recs[i];
+        Patient* p = (r->type >= REGULAR && r->type <= ICU) ? patient_alloc() : NULL;
+        if (!p) {
+            (*skipped)++;
+            continue;
+        }
+        char name[IDENT_NAME_MAX];
+        memcpy(name, r->name, sizeof(name));
+        name[sizeof(name)-1] = '\0';
+        p->ident = identity_intern(name, 0);
+        p->type = (PatientType)r->type;
+        p->severity = r->severity;
+        p->isICU = r->isICU;
+        p->age = r->age;
+        p->check_in_time = (time_t)r->check_in_time;
+        batch[nbatch++] = p;
+        if (nbatch == LOAD_BATCH) {
+            loaded += add_patients_bulk(h, batch, nbatch);
+            nbatch = 0;
+        }
+    }
+    loaded += add_patients_bulk(h, batch, nbatch);
+    return loaded;
+}
+
+// Load an intake file (CSV or binary); returns the number of patients queued or -1
+long load_patients_file(Hospital* h, const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "[ERROR] Cannot open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        return st.st_size == 0 ? 0 : -1;
+    }
+    size_t size = (size_t)st.st_size;
+    char* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "[ERROR] Cannot map %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    madvise(data, size, MADV_SEQUENTIAL);
+    uint64_t t0 = now_ns();
+    long skipped = 0, loaded;
+    if (size >= sizeof(IntakeFileHeader) && ((const IntakeFileHeader*)data)->magic == INTAKE_MAGIC)
+        loaded = load_binary(h, data, size, &skipped);
+    else
+        loaded = load_csv(h, data, size, &skipped);
+    munmap(data, size);
+    console_printf(COLOR_BOLD COLOR_GREEN "[LOAD] %ld patients queued from %s in %.3fs (%ld skipped)\n" COLOR_RESET,
+           loaded, path, (double)(now_ns() - t0) / 1e9, skipped);
+    return loaded;
+}
+
+// ------------- NETWORK FRONT-END -------------
+// Single-threaded epoll server for registration kiosks and dashboards.
+// Line protocol, one request per line, one response line each:
+//   ADD <severity> <icu 0|1> <name...>  -> OK <id>
+//   EMERGENCY <name...>                 -> OK <id>
+//   STATUS                              -> STATUS beds=a/b icu=c/d general=e/f queued=n ...
+//                                          forecast=admission:x/y/z,... (free beds in 1m/15m/1h)
+//   DISCHARGE <id>                      -> OK bed=<n> | ERR not admitted
+//   TRANSFER <id> <ICU|GENERAL|ADMISSION> -> OK bed=<n> | ERR ...
+//   HOSPITAL <n>                        -> OK hospital=<n>; later ADD/EMERGENCY/STATUS use shard n
+//   FIND <name|#mrn>                    -> OK <identity>
+//   AUDIT <query>                       -> EVENT <line> per match, then OK events=<n> ... (see events_parse_query)
+//   SUBSCRIBE [version]                 -> census changes of the current shard after version, pushed as they
+//                                          happen: DELTA <v> BED <ward> <bed> <patient|0>, DELTA <v> QUEUE <n>,
+//                                          DELTA <v> HEAD <patient|0> <level>. Without a version, or once it is
+//                                          too old, a SNAPSHOT version=<v> block of the same lines comes first.
+//   UNSUBSCRIBE                         -> OK
+// Sockets are non-blocking; unsent output is buffered per connection and
+// flushed on EPOLLOUT, so a slow client never stalls the others.
+#define NET_MAX_LINE 512
+#define NET_MAX_EVENTS 256
+#define NET_AUDIT_LIMIT 1000 // Most EVENT lines one AUDIT returns
+#define NET_SUB_BACKLOG (256 * 1024) // Unsent bytes at which a subscriber stops being fed until it drains
+#define NET_SUB_BATCH 64
+
+typedef struct NetConn {
+    int fd;
+    int hospital; // Shard index for check-ins and STATUS, 0 by default
+    char in[NET_MAX_LINE];
+    size_t inlen;
+    char* out;
+    size_t outlen;
+    size_t outcap;
+    int subscribed;           // Shard index fed to this connection, or -1
+    uint64_t census_version;  // Last census version sent
+    struct NetConn* next_sub; // Subscriber list links
+    struct NetConn* prev_sub;
+} NetConn;
+
+typedef struct {
+    int listen_fd;
+    int epoll_fd;
+    int wake_fd;   // eventfd; written by net_server_stop
+    int census_fd; // eventfd; poked by census appends, see census_notify_fd
+    NetConn* subscribers;
+    pthread_t thread;
+    atomic_ulong connections;
+    atomic_ulong requests;
+} NetServer;
+
+static void net_unsubscribe(NetServer* srv, NetConn* c) {
+    if (c->subscribed < 0)
+        return;
+    if (c->prev_sub)
+        c->prev_sub->next_sub = c->next_sub;
+    else
+        srv->subscribers = c->next_sub;
+    if (c->next_sub)
+        c->next_sub->prev_sub = c->prev_sub;
+    c->next_sub = c->prev_sub = NULL;
+    c->subscribed = -1;
+}
+
+static void net_close(NetServer* srv, NetConn* c) {
+    net_unsubscribe(srv, c);
+    epoll_ctl(srv->epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    free(c->out);
+    free(c);
+}
+
+// Returns -1 if the connection died
+static int net_flush(NetServer* srv, NetConn* c) {
+    while (c->outlen > 0) {
+        ssize_t n = send(c->fd, c->out, c->outlen, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        memmove(c->out, c->out + n, c->outlen - (size_t)n);
+        c->outlen -= (size_t)n;
+    }
+    struct epoll_event ev = { .events = EPOLLIN | (c->outlen ? EPOLLOUT : 0), .data.ptr = c };
+    epoll_ctl(srv->epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+    return 0;
+}
+
+static void net_reply(NetConn* c, const char* fmt, ...) {
+    char line[NET_MAX_LINE];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(line, sizeof(line) - 1, fmt, ap);
+    va_end(ap);
+    if (n < 0)
+        return;
+    if ((size_t)n > sizeof(line) - 2)
+        n = (int)sizeof(line) - 2;
+    line[n++] = '\n';
+    if (c->outlen + (size_t)n > c->outcap) {
+        size_t cap = c->outcap ? c->outcap * 2 : 1024;
+        while (cap < c->outlen + (size_t)n)
+            cap *= 2;
+        char* grown = realloc(c->out, cap);
+        if (!grown)
+            return;
+        c->out = grown;
+        c->outcap = cap;
+    }
+    memcpy(c->out + c->outlen, line, (size_t)n);
+    c->outlen += (size_t)n;
+}
+
+static void net_audit_event(const EventRecord* r, void* arg) {
+    char line[256];
+    events_format(r, line, sizeof(line));
+    net_reply(arg, "EVENT %s", line);
+}
+
+// Returns 0, or -1 (after an ERR line) if no snapshot could be taken
+static int net_census_snapshot(NetConn* c, Hospital* h) {
+    CensusDelta* d;
+    long n = occ_census_snapshot(&h->occupants, &d);
+    if (n < 0) {
+        net_reply(c, "ERR out of memory");
+        return -1;
+    }
+    unsigned long long v = (unsigned long long)d[0].version;
+    net_reply(c, "SNAPSHOT version=%llu hospital=%d", v, h->index);
+    for (long i = 0; i < n; ++i) {
+        char line[96];
+        census_format(&d[i], line, sizeof(line));
+        net_reply(c, "%s", line);
+    }
+    net_reply(c, "OK version=%llu", v);
+    c->census_version = d[0].version;
+    free(d);
+    return 0;
+}
+
+// Queue the census entries a subscriber has not seen, up to its backlog
+// limit; one that fell out of the ring gets a fresh snapshot
+static void net_census_push(NetConn* c) {
+    Hospital* h = hospital_at(c->subscribed);
+    CensusDelta d[NET_SUB_BATCH];
+    uint64_t latest;
+    while (h && c->outlen < NET_SUB_BACKLOG) {
+        long n = census_read(&h->census, c->census_version, d, NET_SUB_BATCH, &latest);
+        if (n < 0) {
+            if (net_census_snapshot(c, h) < 0)
+                break;
+            continue;
+        }
+        for (long i = 0; i < n; ++i) {
+            char line[96];
+            census_format(&d[i], line, sizeof(line));
+            net_reply(c, "DELTA %llu %s", (unsigned long long)d[i].version, line);
+            c->census_version = d[i].version;
+        }
+        if (n < NET_SUB_BATCH)
+            break;
+    }
+}
+
+static void net_handle_line(NetServer* srv, NetConn* c, char* line) {
+    char* rest = line;
+    char* verb = strsep(&rest, " \t");
+    if (!verb || !*verb)
+        return;
+    Hospital* h = hospital_at(c->hospital);
+    if (strcasecmp(verb, "ADD") == 0) {
+        int sev, icu, used = 0;
+        if (!rest || sscanf(rest, "%d %d %n", &sev, &icu, &used) < 2 || !rest[used]) {
+            net_reply(c, "ERR usage: ADD <severity> <icu> <name>");
+            return;
+        }
+        int id = add_patient(h, rest + used, icu ? ICU : REGULAR, sev, icu);
+        if (id < 0)
+            net_reply(c, "ERR check-in failed");
+        else
+            net_reply(c, "OK %d", id);
+    } else if (strcasecmp(verb, "EMERGENCY") == 0) {
+        if (!rest || !*rest) {
+            net_reply(c, "ERR usage: EMERGENCY <name>");
+            return;
+        }
+        int id = add_patient(h, rest, EMERGENCY, 10, 1);
+        if (id < 0)
+            net_reply(c, "ERR check-in failed");
+        else
+            net_reply(c, "OK %d", id);
+    } else if (strcasecmp(verb, "STATUS") == 0) {
+        HospitalStatus st;
+        status_read(h, &st);
+        char forecast[NET_MAX_LINE / 2];
+        int len = 0;
+        for (int w = 0; w < WARD_COUNT && len < (int)sizeof(forecast); ++w) {
+            len += snprintf(forecast + len, sizeof(forecast) - len, "%s", w ? "," : "");
+            for (const char* n = ward_names[w]; *n && len < (int)sizeof(forecast) - 1; ++n)
+                forecast[len++] = (char)tolower((unsigned char)*n);
+            for (int f = 0; f < FORECAST_HORIZONS && len < (int)sizeof(forecast); ++f)
+                len += snprintf(forecast + len, sizeof(forecast) - len, "%c%d", f ? '/' : ':', st.forecast_free[w][f]);
+        }
+        net_reply(c, "STATUS beds=%d/%d icu=%d/%d general=%d/%d queued=%d admitted=%lu discharged=%lu version=%u forecast=%s",
+                  st.occupied[WARD_ADMISSION], st.capacity[WARD_ADMISSION],
+                  st.occupied[WARD_ICU], st.capacity[WARD_ICU],
+                  st.occupied[WARD_GENERAL], st.capacity[WARD_GENERAL],
+                  st.queued, st.admitted, st.discharged, st.version, forecast);
+    } else if (strcasecmp(verb, "DISCHARGE") == 0) {
+        char* endp;
+        long id = rest ? strtol(rest, &endp, 10) : 0;
+        if (!rest || endp == rest || id <= 0) {
+            net_reply(c, "ERR usage: DISCHARGE <id>");
+            return;
+        }
+        int bed = discharge_patient_id((int)id);
+        if (bed < 0)
+            net_reply(c, "ERR not admitted");
+        else
+            net_reply(c, "OK bed=%d", bed);
+    } else if (strcasecmp(verb, "TRANSFER") == 0) {
+        int id = 0;
+        char ward[16] = "";
+        WardId to = WARD_COUNT;
+        if (rest && sscanf(rest, "%d %15s", &id, ward) == 2)
+            to = ward_parse(ward);
+        if (id <= 0 || to == WARD_COUNT) {
+            net_reply(c, "ERR usage: TRANSFER <id> <ICU|GENERAL|ADMISSION>");
+            return;
+        }
+        int bed = transfer_patient(id, to);
+        if (bed < 0)
+            net_reply(c, "ERR not admitted or ward full");
+        else
+            net_reply(c, "OK bed=%d", bed);
+    } else if (strcasecmp(verb, "HOSPITAL") == 0) {
+        int index;
+        if (!rest || sscanf(rest, "%d", &index) != 1 || !hospital_at(index)) {
+            net_reply(c, "ERR usage: HOSPITAL <0-%d>", hospital_count - 1);
+            return;
+        }
+        c->hospital = index;
+        net_reply(c, "OK hospital=%d", index);
+    } else if (strcasecmp(verb, "FIND") == 0) {
+        IdentityHandle who = rest ? identity_lookup(rest) : 0;
+        if (!who) {
+            net_reply(c, "ERR usage: FIND <name|#mrn> (no such patient)");
+            return;
+        }
+        char desc[256];
+        identity_describe(who, desc, sizeof(desc));
+        net_reply(c, "OK %s", desc);
+    } else if (strcasecmp(verb, "AUDIT") == 0) {
+        EventQuery q;
+        if (!events.dir[0]) {
+            net_reply(c, "ERR event store disabled");
+            return;
+        }
+        if (!rest || events_parse_query(rest, &q) < 0) {
+            net_reply(c, "ERR usage: AUDIT patient=<id>|mrn=<n>|name=<name> event=<type> ward=<ward> since=<date|Nd> until=<date|Nd> limit=<n>");
+            return;
+        }
+        if (q.limit == 0 || q.limit > NET_AUDIT_LIMIT)
+            q.limit = NET_AUDIT_LIMIT;
+        EventQueryStats st;
+        uint64_t t0 = now_ns();
+        if (events_query(events.dir, &q, net_audit_event, c, &st) < 0) {
+            net_reply(c, "ERR event store unreadable");
+            return;
+        }
+        net_reply(c, "OK events=%lu truncated=%d segments=%d indexed=%d scanned=%lu ms=%.3f", st.matches,
+                  st.truncated, st.segments, st.indexed, st.scanned, (double)(now_ns() - t0) / 1e6);
+    } else if (strcasecmp(verb, "SUBSCRIBE") == 0) {
+        char* end = NULL;
+        unsigned long long since = rest && *rest ? strtoull(rest, &end, 10) : 0;
+        if (end && *end) {
+            net_reply(c, "ERR usage: SUBSCRIBE [version]");
+            return;
+        }
+        net_unsubscribe(srv, c);
+        c->subscribed = h->index;
+        c->next_sub = srv->subscribers;
+        if (srv->subscribers)
+            srv->subscribers->prev_sub = c;
+        srv->subscribers = c;
+        uint64_t latest;
+        CensusDelta probe;
+        if (end && census_read(&h->census, since, &probe, 0, &latest) == 0) {
+            c->census_version = since;
+            net_reply(c, "OK version=%llu", since);
+        } else if (net_census_snapshot(c, h) < 0) {
+            net_unsubscribe(srv, c);
+            return;
+        }
+        net_census_push(c);
+    } else if (strcasecmp(verb, "UNSUBSCRIBE") == 0) {
+        net_unsubscribe(srv, c);
+        net_reply(c, "OK");
+    } else {
+        net_reply(c, "ERR unknown command");
+    }
+}
+
+// Returns -1 when the connection should be closed
+static int net_read(NetServer* srv, NetConn* c) {
+    for (;;) {
+        ssize_t n = recv(c->fd, c->in + c->inlen, sizeof(c->in) - c->inlen, 0);
+        if (n == 0)
+            return -1;
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        c->inlen += (size_t)n;
+        char* start = c->in;
+        char* nl;
+        while ((nl = memchr(start, '\n', c->inlen - (size_t)(start - c->in)))) {
+            *nl = '\0';
+            if (nl > start && nl[-1] == '\r')
+                nl[-1] = '\0';
+            net_handle_line(srv, c, start);
+            atomic_fetch_add_explicit(&srv->requests, 1, memory_order_relaxed);
+            start = nl + 1;
+        }
+        c->inlen -= (size_t)(start - c->in);
+        memmove(c->in, start, c->inlen);
+        if (c->inlen == sizeof(c->in)) {
+            net_reply(c, "ERR line too long");
+            net_flush(srv, c);
+            return -1;
+        }
+    }
+    return net_flush(srv, c);
+}
+
+static void net_accept(NetServer* srv) {
+    for (;;) {
+        int fd = accept4(srv->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            return; // EAGAIN, or transient errors such as EMFILE
+        NetConn* c = calloc(1, sizeof(NetConn));
+        if (!c) {
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->subscribed = -1;
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+        if (epoll_ctl(srv->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            close(fd);
+            free(c);
+            continue;
+        }
+        atomic_fetch_add_explicit(&srv->connections, 1, memory_order_relaxed);
+    }
+}
+
+static void* net_server_loop(void* arg) {
+    NetServer* srv = (NetServer*)arg;
+    struct epoll_event events[NET_MAX_EVENTS];
+    for (;;) {
+        int n = epoll_wait(srv->epoll_fd, events, NET_MAX_EVENTS, -1);
+        if (n < 0 && errno != EINTR)
+            break;
+        int census_ready = 0;
+        for (int i = 0; i < n; ++i) {
+            void* tag = events[i].data.ptr;
+            if (tag == &srv->wake_fd)
+                return NULL;
+            if (tag == &srv->listen_fd) {
+                net_accept(srv);
+                continue;
+            }
+            if (tag == &srv->census_fd) {
+                census_ready = 1; // Fanned out after the batch, see below
+                continue;
+            }
+            NetConn* c = tag;
+            int dead = (events[i].events & (EPOLLERR | EPOLLHUP)) != 0;
+            if (!dead && (events[i].events & EPOLLIN))
+                dead = net_read(srv, c) < 0;
+            else if (!dead && (events[i].events & EPOLLOUT)) {
+                dead = net_flush(srv, c) < 0;
+                if (!dead && c->subscribed >= 0 && c->outlen == 0) {
+                    net_census_push(c); // Catch up after backing off at the backlog limit
+                    dead = net_flush(srv, c) < 0;
+                }
+            }
+            if (dead)
+                net_close(srv, c);
+        }
+        // Feeding subscribers can close any of them, so it waits until no
+        // event of this batch can still point at a freed connection
+        if (census_ready) {
+            uint64_t count;
+            ssize_t rc = read(srv->census_fd, &count, sizeof(count));
+            (void)rc;
+            atomic_store(&census_notify_pending, 0); // Appends from here on poke again
+            for (NetConn* s = srv->subscribers, *next; s; s = next) {
+                next = s->next_sub;
+                net_census_push(s);
+                if (net_flush(srv, s) < 0)
+                    net_close(srv, s);
+            }
+        }
+    }
+    return NULL;
+}
+
+int net_server_start(NetServer* srv, const char* addr, int port) {
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, addr, &sa.sin_addr) != 1) {
+        fprintf(stderr, "[ERROR] Bad listen address %s\n", addr);
+        return -1;
+    }
+    srv->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    if (srv->listen_fd < 0
+        || setsockopt(srv->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0
+        || bind(srv->listen_fd, (struct sockaddr*)&sa, sizeof(sa)) < 0
+        || listen(srv->listen_fd, SOMAXCONN) < 0) {
+        fprintf(stderr, "[ERROR] Cannot listen on %s:%d: %s\n", addr, port, strerror(errno));
+        if (srv->listen_fd >= 0)
+            close(srv->listen_fd);
+        srv->listen_fd = -1;
+        return -1;
+    }
+    srv->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    srv->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    srv->census_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event lev = { .events = EPOLLIN, .data.ptr = &srv->listen_fd };
+    struct epoll_event wev = { .events = EPOLLIN, .data.ptr = &srv->wake_fd };
+    struct epoll_event cev = { .events = EPOLLIN, .data.ptr = &srv->census_fd };
+    if (srv->epoll_fd < 0 || srv->wake_fd < 0 || srv->census_fd < 0
+        || epoll_ctl(srv->epoll_fd, EPOLL_CTL_ADD, srv->listen_fd, &lev) < 0
+        || epoll_ctl(srv->epoll_fd, EPOLL_CTL_ADD, srv->wake_fd, &wev) < 0
+        || epoll_ctl(srv->epoll_fd, EPOLL_CTL_ADD, srv->census_fd, &cev) < 0
+        || pthread_create(&srv->thread, NULL, net_server_loop, srv) != 0) {
+        fprintf(stderr, "[ERROR] Cannot start network server: %s\n", strerror(errno));
+        close(srv->listen_fd);
+        if (srv->epoll_fd >= 0)
+            close(srv->epoll_fd);
+        if (srv->wake_fd >= 0)
+            close(srv->wake_fd);
+        if (srv->census_fd >= 0)
+            close(srv->census_fd);
+        srv->listen_fd = srv->epoll_fd = srv->wake_fd = srv->census_fd = -1;
+        return -1;
+    }
+    census_notify_fd = srv->census_fd;
+    console_printf(COLOR_BOLD COLOR_GREEN "[INFO] Listening for check-ins on %s:%d\n" COLOR_RESET, addr, port);
+    return 0;
+}
+
+// Connections still open are closed by process exit
+void net_server_stop(NetServer* srv) {
+    if (srv->listen_fd < 0)
+        return;
+    uint64_t one = 1;
+    if (write(srv->wake_fd, &one, sizeof(one)) < 0)
+        perror("eventfd write");
+    pthread_join(srv->thread, NULL);
+    close(srv->listen_fd);
+    close(srv->epoll_fd);
+    close(srv->wake_fd);
+    // census_fd stays open: shard threads may still poke it until they stop
+    srv->listen_fd = srv->epoll_fd = srv->wake_fd = -1;
+}
+
+// ------------- DISCRETE-EVENT SIMULATION -------------
+// Runs the admission, discharge and ward allocation logic above against a
+// virtual clock: events sit in a min-heap keyed on virtual time and are
+// executed back to back, so a month of census takes seconds. Every
+// Simulation owns its queue, wards and patient pool, and all randomness
+// comes from a seeded generator, so runs are reproducible and independent.
+typedef struct {
+    int days;
+    uint64_t seed;
+    double arrivals_per_hour;      // Queue (add_patient) arrivals
+    double mean_stay_hours;        // Admission-ward length of stay
+    double ward_arrivals_per_hour; // Direct ICU/General requests (allocate_bed)
+    double mean_ward_stay_hours;
+    int mix[4];                    // REGULAR, EMERGENCY, GENERAL, ICU weights
+    int beds[WARD_COUNT];
+    int aging_secs;
+} SimConfig;
+
+#define SIM_DEFAULT_CONFIG { 30, 42, 0.18, 24.0, 0.15, 72.0, { 70, 20, 5, 5 }, \
+                             { WARD_LAYOUT(WARD_BEDS) }, PQ_DEFAULT_AGING_SECS }
+
+typedef struct {
+    uint64_t events;
+    uint64_t admitted;
+    uint64_t ward_served;
+    uint64_t still_queued;
+    uint64_t still_parked;
+    int max_queue;
+    double mean_occupancy[WARD_COUNT]; // Time-weighted beds in use
+    // Wait times in virtual seconds, sorted ascending
+    uint32_t* queue_waits;
+    size_t nqueue_waits;
+    uint32_t* ward_waits;
+    size_t nward_waits;
+    // When set (sim_run_hist), waits are counted here instead of the arrays
+    HistSnapshot* queue_hist;
+    HistSnapshot* ward_hist;
+    double wall_seconds;
+} SimResult;
+
+typedef enum { SIM_ARRIVAL, SIM_DISCHARGE, SIM_WARD_REQUEST, SIM_WARD_RELEASE } SimEventType;
+
+typedef struct {
+    uint64_t at_ms;
+    uint64_t seq;
+    SimEventType type;
+    int bed;
+    void* data;
+} SimEvent;
+
+typedef struct {
+    SimConfig cfg;
+    SimResult* res;
+    uint64_t now_ms;
+    uint64_t rng;
+    uint64_t next_seq;
+    int next_id;
+    SimEvent* heap;
+    size_t nheap;
+    size_t heap_cap;
+    PatientPool pool;
+    PriorityQueue queue;
+    Ward wards[WARD_COUNT];
+    uint64_t occ_since_ms;
+    double occ_area[WARD_COUNT]; // Bed-milliseconds
+    size_t queue_waits_cap;
+    size_t ward_waits_cap;
+} Simulation;
+
+typedef struct {
+    BedRequest req; // Must stay first
+    Simulation* sim;
+    uint64_t requested_ms;
+} SimWardRequest;
+
+static uint64_t sim_rand(Simulation* sim) {
+    uint64_t z = (sim->rng += 0x9E3779B97F4A7C15ull); // splitmix64
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static double sim_uniform(Simulation* sim) {
+    return ((double)(sim_rand(sim) >> 11) + 0.5) / 9007199254740992.0;
+}
+
+static uint64_t sim_exp_ms(Simulation* sim, double mean_hours) {
+    return (uint64_t)(-log(sim_uniform(sim)) * mean_hours * 3600000.0) + 1;
+}
+
+static int sim_event_before(const SimEvent* a, const SimEvent* b) {
+    return a->at_ms < b->at_ms || (a->at_ms == b->at_ms && a->seq < b->seq);
+}
+
+static int sim_schedule(Simulation* sim, uint64_t delay_ms, SimEventType type, int bed, void* data) {
+    if (sim->nheap == sim->heap_cap) {
+        size_t cap = sim->heap_cap ? sim->heap_cap * 2 : 1024;
+        SimEvent* grown = realloc(sim->heap, sizeof(SimEvent) * cap);
+        if (!grown)
+            return -1;
+        sim->heap = grown;
+        sim->heap_cap = cap;
+    }
+    SimEvent ev = { sim->now_ms + delay_ms, sim->next_seq++, type, bed, data };
+    size_t i = sim->nheap++;
+    while (i > 0 && sim_event_before(&ev, &sim->heap[(i - 1) / 2])) {
+        sim->heap[i] = sim->heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    sim->heap[i] = ev;
+    return 0;
+}
+
+static SimEvent sim_next_event(Simulation* sim) {
+    SimEvent top = sim->heap[0];
+    SimEvent last = sim->heap[--sim->nheap];
+    size_t i = 0, n = sim->nheap;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= n)
+            break;
+        if (child + 1 < n && sim_event_before(&sim->heap[child + 1], &sim->heap[child]))
+            child++;
+        if (!sim_event_before(&sim->heap[child], &last))
+            break;
+        sim->heap[i] = sim->heap[child];
+        i = child;
+    }
+    if (n > 0)
+        sim->heap[i] = last;
+    return top;
+}
+
+static void sim_record_wait(uint32_t** waits, size_t* n, size_t* cap, HistSnapshot* hist, uint64_t wait_ms) {
+    if (hist) {
+        hist_add(hist, wait_ms / 1000);
+        return;
+    }
+    if (*n == *cap) {
+        size_t grown_cap = *cap ? *cap * 2 : 4096;
+        uint32_t* grown = realloc(*waits, sizeof(uint32_t) * grown_cap);
+        if (!grown)
+            return;
+        *waits = grown;
+        *cap = grown_cap;
+    }
+    (*waits)[(*n)++] = (uint32_t)(wait_ms / 1000);
+}
+
+// Accumulate bed-time for every ward up to the current virtual time
+static void sim_account_occupancy(Simulation* sim) {
+    uint64_t dt = sim->now_ms - sim->occ_since_ms;
+    for (int i = 0; i < WARD_COUNT; ++i)
+        sim->occ_area[i] += (double)dt * ward_occupied(&sim->wards[i]);
+    sim->occ_since_ms = sim->now_ms;
+}
+
+static time_t sim_now_s(const Simulation* sim) {
+    return (time_t)(sim->now_ms / 1000);
+}
+
+static PatientType sim_pick_type(Simulation* sim) {
+    int total = sim->cfg.mix[0] + sim->cfg.mix[1] + sim->cfg.mix[2] + sim->cfg.mix[3];
+    int pick = (int)(sim_rand(sim) % (uint64_t)total);
+    PatientType type = REGULAR;
+    while (type < ICU && pick >= sim->cfg.mix[type]) {
+        pick -= sim->cfg.mix[type];
+        type++;
+    }
+    return type;
+}
+
+static void sim_admit_ready(Simulation* sim) {
+    Ward* w = &sim->wards[WARD_ADMISSION];
+    Patient* p;
+    int bed;
+    while ((bed = admit_next(&sim->queue, w, sim_now_s(sim), &p)) >= 0) {
+        sim_record_wait(&sim->res->queue_waits, &sim->res->nqueue_waits, &sim->queue_waits_cap, sim->res->queue_hist,
+                        sim->now_ms - (uint64_t)p->check_in_time * 1000);
+        sim->res->admitted++;
+        patient_free_to(&sim->pool, p);
+        sim_schedule(sim, sim_exp_ms(sim, sim->cfg.mean_stay_hours), SIM_DISCHARGE, bed, NULL);
+    }
+}
+
+static void sim_ward_granted(Task* t) {
+    SimWardRequest* r = (SimWardRequest*)t;
+    Simulation* sim = r->sim;
+    sim_record_wait(&sim->res->ward_waits, &sim->res->nward_waits, &sim->ward_waits_cap, sim->res->ward_hist,
+                    sim->now_ms - r->requested_ms);
+    sim->res->ward_served++;
+    sim_schedule(sim, sim_exp_ms(sim, sim->cfg.mean_ward_stay_hours), SIM_WARD_RELEASE, r->req.bed, r);
+}
+
+static void sim_free_ward_request(Simulation* sim, SimWardRequest* r) {
+    patient_free_to(&sim->pool, r->req.patient);
+    free(r);
+}
+
+static void sim_handle(Simulation* sim, const SimEvent* ev) {
+    switch (ev->type) {
+    case SIM_ARRIVAL: {
+        Patient* p = patient_alloc_from(&sim->pool);
+        if (p) {
+            p->id = sim->next_id++;
+            p->type = sim_pick_type(sim);
+            p->severity = (int)(sim_rand(sim) % PQ_SEVERITY_LEVELS) + 1;
+            p->isICU = (p->type == ICU);
+            p->check_in_time = sim_now_s(sim);
+            if (pq_push(&sim->queue, p) < 0)
+                patient_free_to(&sim->pool, p);
+            if (sim->queue.size > sim->res->max_queue)
+                sim->res->max_queue = sim->queue.size;
+        }
+        sim_admit_ready(sim);
+        sim_schedule(sim, sim_exp_ms(sim, 1.0 / sim->cfg.arrivals_per_hour), SIM_ARRIVAL, -1, NULL);
+        break;
+    }
+    case SIM_DISCHARGE:
+        ward_release(&sim->wards[WARD_ADMISSION], ev->bed);
+        sim_admit_ready(sim);
+        break;
+    case SIM_WARD_REQUEST: {
+        SimWardRequest* r = malloc(sizeof(SimWardRequest));
+        Patient* p = r ? patient_alloc_from(&sim->pool) : NULL;
+        if (p) {
+            p->id = sim->next_id++;
+            p->severity = (int)(sim_rand(sim) % PQ_SEVERITY_LEVELS) + 1;
+            p->type = (p->severity > 6) ? ICU : GENERAL;
+            r->req.task.fn = sim_ward_granted;
+            r->req.task.pool = NULL;
+            r->req.patient = p;
+            r->req.ward = &sim->wards[ward_for(p)];
+            r->sim = sim;
+            r->requested_ms = sim->now_ms;
+            r->req.bed = ward_alloc_or_park(r->req.ward, &r->req);
+            if (r->req.bed >= 0)
+                sim_ward_granted(&r->req.task);
+        } else {
+            free(r);
+        }
+        sim_schedule(sim, sim_exp_ms(sim, 1.0 / sim->cfg.ward_arrivals_per_hour), SIM_WARD_REQUEST, -1, NULL);
+        break;
+    }
+    case SIM_WARD_RELEASE: {
+        SimWardRequest* r = ev->data;
+        ward_release(r->req.ward, r->req.bed); // May resume a parked request inline
+        sim_free_ward_request(sim, r);
+        break;
+    }
+    }
+}
+
+static int sim_cmp_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Run one simulation to completion; the caller frees the result with sim_result_free.
+// With queue_hist/ward_hist set, waits are added to them and the arrays stay empty.
+int sim_run_hist(const SimConfig* cfg, SimResult* res, HistSnapshot* queue_hist, HistSnapshot* ward_hist) {
+    memset(res, 0, sizeof(*res));
+    res->queue_hist = queue_hist;
+    res->ward_hist = ward_hist;
+    if (cfg->days <= 0 || cfg->arrivals_per_hour <= 0 || cfg->ward_arrivals_per_hour <= 0
+        || cfg->mix[0] + cfg->mix[1] + cfg->mix[2] + cfg->mix[3] <= 0)
+        return -1;
+    Simulation* sim = calloc(1, sizeof(Simulation));
+    if (!sim)
+        return -1;
+    sim->cfg = *cfg;
+    sim->res = res;
+    sim->rng = cfg->seed;
+    sim->next_id = 1;
+    patient_pool_init(&sim->pool);
+    pq_init(&sim->queue);
+    pq_set_aging(&sim->queue, cfg->aging_secs, PQ_LEVEL(EMERGENCY, 1));
+    for (int i = 0; i < WARD_COUNT; ++i) {
+        if (ward_init(&sim->wards[i], ward_names[i], cfg->beds[i]) < 0) {
+            for (int j = 0; j <= i; ++j)
+                ward_destroy(&sim->wards[j]);
+            pq_destroy(&sim->queue);
+            free(sim);
+            return -1;
+        }
+    }
+
+    uint64_t horizon_ms = (uint64_t)cfg->days * 24 * 3600000ull;
+    uint64_t wall0 = now_ns();
+    sim_schedule(sim, sim_exp_ms(sim, 1.0 / cfg->arrivals_per_hour), SIM_ARRIVAL, -1, NULL);
+    sim_schedule(sim, sim_exp_ms(sim, 1.0 / cfg->ward_arrivals_per_hour), SIM_WARD_REQUEST, -1, NULL);
+    while (sim->nheap > 0 && sim->heap[0].at_ms <= horizon_ms) {
+        SimEvent ev = sim_next_event(sim);
+        sim->now_ms = ev.at_ms;
+        sim_account_occupancy(sim);
+        sim_handle(sim, &ev);
+        res->events++;
+    }
+    sim->now_ms = horizon_ms;
+    sim_account_occupancy(sim);
+    res->wall_seconds = (double)(now_ns() - wall0) / 1e9;
+    for (int i = 0; i < WARD_COUNT; ++i)
+        res->mean_occupancy[i] = sim->occ_area[i] / (double)horizon_ms;
+    res->still_queued = (uint64_t)sim->queue.size;
+
+    // Release everything still in flight
+    for (size_t i = 0; i < sim->nheap; ++i)
+        if (sim->heap[i].type == SIM_WARD_RELEASE)
+            sim_free_ward_request(sim, sim->heap[i].data);
+    for (int i = 0; i < WARD_COUNT; ++i) {
+        BedRequest* r;
+        while ((r = ward_cancel_waiter(&sim->wards[i]))) {
+            res->still_parked++;
+            sim_free_ward_request(sim, (SimWardRequest*)r);
+        }
+        ward_destroy(&sim->wards[i]);
+    }
+    free(sim->heap);
+    pq_destroy(&sim->queue);
+    patient_pool_destroy(&sim->pool);
+    free(sim);
+
+    qsort(res->queue_waits, res->nqueue_waits, sizeof(uint32_t), sim_cmp_u32);
+    qsort(res->ward_waits, res->nward_waits, sizeof(uint32_t), sim_cmp_u32);
+    return 0;
+}
+
+int sim_run(const SimConfig* cfg, SimResult* res) {
+    return sim_run_hist(cfg, res, NULL, NULL);
+}
+
+void sim_result_free(SimResult* res) {
+    free(res->queue_waits);
+    free(res->ward_waits);
+    res->queue_waits = res->ward_waits = NULL;
+}
+
+// Wait-time percentile in virtual seconds over a sorted sample
+static uint32_t sim_percentile(const uint32_t* sorted, size_t n, double pct) {
+    if (n == 0)
+        return 0;
+    return sorted[(size_t)(pct / 100.0 * (double)(n - 1) + 0.5)];
+}
+
+void sim_print_report(const SimConfig* cfg, const SimResult* res) {
+    printf(COLOR_BOLD COLOR_CYAN "[SIMULATION] %d days, seed %llu\n" COLOR_RESET, cfg->days, (unsigned long long)cfg->seed);
+    printf("  Events: %llu in %.3fs (%.2fM events/s)\n", (unsigned long long)res->events, res->wall_seconds,
+           res->wall_seconds > 0 ? (double)res->events / res->wall_seconds / 1e6 : 0.0);
+    printf("  Admitted: %llu  still queued: %llu  max queue: %d\n",
+           (unsigned long long)res->admitted, (unsigned long long)res->still_queued, res->max_queue);
+    printf("  Queue wait (min): p50=%.1f p99=%.1f p999=%.1f\n",
+           sim_percentile(res->queue_waits, res->nqueue_waits, 50.0) / 60.0,
+           sim_percentile(res->queue_waits, res->nqueue_waits, 99.0) / 60.0,
+           sim_percentile(res->queue_waits, res->nqueue_waits, 99.9) / 60.0);
+    printf("  ICU/General served: %llu  still waiting: %llu\n",
+           (unsigned long long)res->ward_served, (unsigned long long)res->still_parked);
+    printf("  Ward wait (min): p50=%.1f p99=%.1f p999=%.1f\n",
+           sim_percentile(res->ward_waits, res->nward_waits, 50.0) / 60.0,
+           sim_percentile(res->ward_waits, res->nward_waits, 99.0) / 60.0,
+           sim_percentile(res->ward_waits, res->nward_waits, 99.9) / 60.0);
+    printf("  Mean occupancy: Admission %.2f/%d  ICU %.2f/%d  General %.2f/%d\n",
+           res->mean_occupancy[WARD_ADMISSION], cfg->beds[WARD_ADMISSION],
+           res->mean_occupancy[WARD_ICU], cfg->beds[WARD_ICU],
+           res->mean_occupancy[WARD_GENERAL], cfg->beds[WARD_GENERAL]);
+}
+
+// ------------- CAPACITY PLANNER -------------
+// What-if sweeps over bed counts, lengths of stay and arrival mixes. Every
+// (configuration, replica) pair is an independent sim_run with its own
+// queue, wards and pool. Jobs are dealt out to the planner threads in
+// contiguous ranges. A thread works its own range from the front; once that
+// range is empty it steals from the back of another thread's range. Each
+// replica k uses seed base+k in every configuration (common random numbers),
+// so differences between configurations are not seed noise. Waits are
+// merged into per-configuration log-linear histograms.
+#define PLAN_MAX_VALUES 32
+#define PLAN_MAX_CONFIGS 4096
+
 typedef struct {
-    int id;
-    char name[64];
-    int age; // Some code uses age
-    PatientType type;
-    int severity; // For ICU/general distinction
-    time_t check_in_time;
-    int isICU; // For code that uses ICU flag
-} Patient;
+    SimConfig base;
+    int bed_lo[WARD_COUNT], bed_hi[WARD_COUNT], bed_step[WARD_COUNT];
+    double stay[PLAN_MAX_VALUES];       // Admission-ward mean stay, hours
+    int nstay;
+    double ward_stay[PLAN_MAX_VALUES];  // ICU/General mean stay, hours
+    int nward_stay;
+    int mix[PLAN_MAX_VALUES][4];
+    int nmix;
+    int runs;                           // Replicas per configuration
+    int threads;
+    double target_p99_min;              // Cheapest layout meeting this p99 wait; 0 disables
+} PlanSpec;
 
-// ------------- PRIORITY QUEUE -----------
 typedef struct {
-    Patient* patients[MAX_PATIENTS];
-    int size;
-    pthread_mutex_t lock;
-} PriorityQueue;
+    SimConfig cfg;
+    pthread_mutex_t lock; // Merges from concurrent replicas
+    HistSnapshot queue_hist;
+    HistSnapshot ward_hist;
+    double occupancy[WARD_COUNT];
+    uint64_t admitted;
+    uint64_t still_queued;
+    int failed;
+} PlanConfig;
 
-void pq_init(PriorityQueue* pq) {
-    pq->size = 0;
-    pthread_mutex_init(&pq->lock, NULL);   
+// Work range [lo, hi) packed as lo << 32 | hi so owner and thieves race on one CAS
+typedef struct {
+    _Alignas(CACHE_LINE) _Atomic uint64_t range;
+} PlanRange;
+
+typedef struct {
+    PlanConfig* configs;
+    int nconfigs;
+    int runs;
+    PlanRange* ranges;
+    int nthreads;
+    atomic_ulong stolen;
+} Planner;
+
+// Owner takes from the front (from_back = 0), thieves from the back; -1 when empty
+static int plan_take(PlanRange* r, int from_back) {
+    uint64_t cur = atomic_load_explicit(&r->range, memory_order_relaxed);
+    for (;;) {
+        uint32_t lo = (uint32_t)(cur >> 32), hi = (uint32_t)cur;
+        if (lo >= hi)
+            return -1;
+        uint64_t next = from_back ? ((uint64_t)lo << 32 | (hi - 1)) : ((uint64_t)(lo + 1) << 32 | hi);
+        if (atomic_compare_exchange_weak_explicit(&r->range, &cur, next,
+                                                  memory_order_relaxed, memory_order_relaxed))
+            return (int)(from_back ? hi - 1 : lo);
+    }
 }
 
-// Higher priority for EMERGENCY, FIFO for same priority
-static int patient_cmp(const Patient* a, const Patient* b) {
-    if (a->type != b->type)
-        return (b->type - a->type); // Return if EMERGENCY > REGULAR
-    return (a->check_in_time > b->check_in_time) - (a->check_in_time < b->check_in_time);
+typedef struct {
+    Planner* pl;
+    int self;
+} PlanWorker;
+
+static void* plan_worker(void* arg) {
+    PlanWorker* w = arg;
+    Planner* pl = w->pl;
+    HistSnapshot* local = malloc(2 * sizeof(HistSnapshot));
+    if (!local)
+        return NULL;
+    for (;;) {
+        int job = plan_take(&pl->ranges[w->self], 0);
+        for (int k = 1; job < 0 && k < pl->nthreads; ++k) {
+            job = plan_take(&pl->ranges[(w->self + k) % pl->nthreads], 1);
+            if (job >= 0)
+                atomic_fetch_add(&pl->stolen, 1);
+        }
+        if (job < 0)
+            break;
+        PlanConfig* c = &pl->configs[job / pl->runs];
+        SimConfig cfg = c->cfg;
+        cfg.seed += (uint64_t)(job % pl->runs);
+        memset(local, 0, 2 * sizeof(HistSnapshot));
+        SimResult res;
+        int rc = sim_run_hist(&cfg, &res, &local[0], &local[1]);
+        pthread_mutex_lock(&c->lock);
+        if (rc < 0) {
+            c->failed++;
+        } else {
+            hist_merge(&c->queue_hist, &local[0]);
+            hist_merge(&c->ward_hist, &local[1]);
+            for (int i = 0; i < WARD_COUNT; ++i)
+                c->occupancy[i] += res.mean_occupancy[i];
+            c->admitted += res.admitted;
+            c->still_queued += res.still_queued;
+        }
+        pthread_mutex_unlock(&c->lock);
+        sim_result_free(&res);
+    }
+    free(local);
+    return NULL;
 }
 
-void pq_push(PriorityQueue* pq, Patient* patient) {
-    pthread_mutex_lock(&pq->lock);
-    if (pq->size >= MAX_PATIENTS) {
-        pthread_mutex_unlock(&pq->lock);
-        return;
+static int plan_count(const PlanSpec* spec) {
+    long n = (long)spec->nstay * spec->nward_stay * spec->nmix;
+    for (int i = 0; i < WARD_COUNT && n <= PLAN_MAX_CONFIGS; ++i)
+        n *= (spec->bed_hi[i] - spec->bed_lo[i]) / spec->bed_step[i] + 1;
+    return n > PLAN_MAX_CONFIGS ? -1 : (int)n;
+}
+
+// Expand the sweep into one SimConfig per point, bed counts varying fastest
+static void plan_expand(const PlanSpec* spec, PlanConfig* out) {
+    int n = 0;
+    for (int m = 0; m < spec->nmix; ++m)
+        for (int s = 0; s < spec->nstay; ++s)
+            for (int ws = 0; ws < spec->nward_stay; ++ws) {
+                int beds[WARD_COUNT];
+                memcpy(beds, spec->bed_lo, sizeof(beds));
+                for (;;) {
+                    PlanConfig* c = &out[n++];
+                    c->cfg = spec->base;
+                    memcpy(c->cfg.beds, beds, sizeof(beds));
+                    memcpy(c->cfg.mix, spec->mix[m], sizeof(c->cfg.mix));
+                    c->cfg.mean_stay_hours = spec->stay[s];
+                    c->cfg.mean_ward_stay_hours = spec->ward_stay[ws];
+                    int i = WARD_COUNT - 1;
+                    while (i >= 0 && beds[i] + spec->bed_step[i] > spec->bed_hi[i]) {
+                        beds[i] = spec->bed_lo[i];
+                        --i;
+                    }
+                    if (i < 0)
+                        break;
+                    beds[i] += spec->bed_step[i];
+                }
+            }
+}
+
+// Run the sweep and print one line per configuration; returns 0 or -1
+int plan_run(const PlanSpec* spec) {
+    int nconfigs = plan_count(spec);
+    if (nconfigs <= 0 || spec->runs < 1 || spec->threads < 1) {
+        fprintf(stderr, "[ERROR] Plan needs 1-%d configurations, --plan-runs >= 1 and --plan-threads >= 1\n",
+                PLAN_MAX_CONFIGS);
+        return -1;
     }
-    int i = pq->size++;
-    pq->patients[i] = patient;
-    // Bubble up to maintain priority
-    while (i > 0 && patient_cmp(pq->patients[i], pq->patients[i-1]) < 0)
-        {
-        Patient* tmp = pq->patients[i];
-        pq->patients[i] = pq->patients[i-1];
-        pq->patients[i-1] = tmp;
-        i--;
+    long njobs = (long)nconfigs * spec->runs;
+    if (njobs > UINT32_MAX / 2) {
+        fprintf(stderr, "[ERROR] Plan has too many runs (%ld)\n", njobs);
+        return -1;
     }
-    pthread_mutex_unlock(&pq->lock);
+    Planner pl = { .nconfigs = nconfigs, .runs = spec->runs };
+    pl.nthreads = spec->threads < njobs ? spec->threads : (int)njobs;
+    pl.configs = calloc(nconfigs, sizeof(PlanConfig));
+    pl.ranges = aligned_alloc(64, sizeof(PlanRange) * pl.nthreads);
+    pthread_t* tids = malloc(sizeof(pthread_t) * pl.nthreads);
+    PlanWorker* workers = malloc(sizeof(PlanWorker) * pl.nthreads);
+    if (!pl.configs || !pl.ranges || !tids || !workers) {
+        fprintf(stderr, "[ERROR] Out of memory for %d plan configurations\n", nconfigs);
+        free(pl.configs);
+        free(pl.ranges);
+        free(tids);
+        free(workers);
+        return -1;
+    }
+    plan_expand(spec, pl.configs);
+    for (int i = 0; i < nconfigs; ++i)
+        pthread_mutex_init(&pl.configs[i].lock, NULL);
+    for (int t = 0; t < pl.nthreads; ++t) {
+        uint64_t lo = njobs * t / pl.nthreads, hi = njobs * (t + 1) / pl.nthreads;
+        atomic_init(&pl.ranges[t].range, lo << 32 | hi);
+    }
+    atomic_init(&pl.stolen, 0);
+
+    uint64_t t0 = now_ns();
+    int started = 0;
+    for (int t = 0; t < pl.nthreads; ++t) {
+        workers[t].pl = &pl;
+        workers[t].self = t;
+    }
+    while (started < pl.nthreads && pthread_create(&tids[started], NULL, plan_worker, &workers[started]) == 0)
+        started++;
+    if (started == 0) // Run in the caller; it steals every range
+        plan_worker(&workers[0]);
+    for (int t = 0; t < started; ++t)
+        pthread_join(tids[t], NULL);
+    double wall = (double)(now_ns() - t0) / 1e9;
+
+    printf("# admission icu general stay_h ward_stay_h mix runs queue_p50_min queue_p99_min queue_p999_min "
+           "ward_p50_min ward_p99_min ward_p999_min occ_admission occ_icu occ_general still_queued\n");
+    int best = -1;
+    for (int i = 0; i < nconfigs; ++i) {
+        PlanConfig* c = &pl.configs[i];
+        int ok = spec->runs - c->failed;
+        double q99 = hist_percentile(&c->queue_hist, 99.0) / 60.0;
+        double w99 = hist_percentile(&c->ward_hist, 99.0) / 60.0;
+        printf("%d %d %d %.1f %.1f %d,%d,%d,%d %d %.1f %.1f %.1f %.1f %.1f %.1f %.2f %.2f %.2f %.1f\n",
+               c->cfg.beds[WARD_ADMISSION], c->cfg.beds[WARD_ICU], c->cfg.beds[WARD_GENERAL],
+               c->cfg.mean_stay_hours, c->cfg.mean_ward_stay_hours,
+               c->cfg.mix[REGULAR], c->cfg.mix[EMERGENCY], c->cfg.mix[GENERAL], c->cfg.mix[ICU], ok,
+               hist_percentile(&c->queue_hist, 50.0) / 60.0, q99, hist_percentile(&c->queue_hist, 99.9) / 60.0,
+               hist_percentile(&c->ward_hist, 50.0) / 60.0, w99, hist_percentile(&c->ward_hist, 99.9) / 60.0,
+               ok ? c->occupancy[WARD_ADMISSION] / ok : 0.0, ok ? c->occupancy[WARD_ICU] / ok : 0.0,
+               ok ? c->occupancy[WARD_GENERAL] / ok : 0.0, ok ? (double)c->still_queued / ok : 0.0);
+        if (spec->target_p99_min > 0 && ok && q99 <= spec->target_p99_min && w99 <= spec->target_p99_min) {
+            int total = c->cfg.beds[WARD_ADMISSION] + c->cfg.beds[WARD_ICU] + c->cfg.beds[WARD_GENERAL];
+            if (best < 0 || total < pl.configs[best].cfg.beds[WARD_ADMISSION] + pl.configs[best].cfg.beds[WARD_ICU]
+                                        + pl.configs[best].cfg.beds[WARD_GENERAL])
+                best = i;
+        }
+    }
+    printf(COLOR_BOLD COLOR_CYAN "[PLAN] %d configurations x %d runs in %.2fs on %d threads (%.0f runs/s, %lu stolen)\n"
+           COLOR_RESET, nconfigs, spec->runs, wall, pl.nthreads, wall > 0 ? njobs / wall : 0.0,
+           atomic_load(&pl.stolen));
+    if (spec->target_p99_min > 0) {
+        if (best < 0)
+            printf(COLOR_RED "[PLAN] No configuration keeps p99 waits within %.1f min\n" COLOR_RESET,
+                   spec->target_p99_min);
+        else
+            printf(COLOR_BOLD COLOR_GREEN "[PLAN] Fewest beds with p99 waits within %.1f min: "
+                   "Admission %d  ICU %d  General %d\n" COLOR_RESET, spec->target_p99_min,
+                   pl.configs[best].cfg.beds[WARD_ADMISSION], pl.configs[best].cfg.beds[WARD_ICU],
+                   pl.configs[best].cfg.beds[WARD_GENERAL]);
+    }
+
+    for (int i = 0; i < nconfigs; ++i)
+        pthread_mutex_destroy(&pl.configs[i].lock);
+    free(pl.configs);
+    free(pl.ranges);
+    free(tids);
+    free(workers);
+    return 0;
 }
 
-Patient* pq_pop(PriorityQueue* pq) {
-    pthread_mutex_lock(&pq->lock);
-    if (pq->size == 0) {
-        pthread_mutex_unlock(&pq->lock);
-        return NULL;
+#ifdef HOSPITAL_MICROBENCH
+// ------------- MICROBENCHMARKS -------------
+// Built with -DHOSPITAL_MICROBENCH: times the hot primitives in isolation
+// under 1-64 threads and prints one CSV row per case:
+//   bench,variant,size,threads,ops,seconds,ns_per_op
+// ns_per_op is wall-clock time per operation across all threads. With
+// --compare BASELINE.csv every case is checked against the row with the
+// same bench/variant/size/threads, and the run exits 2 if any is slower
+// than --tolerance percent.
+//   pq      push_pop | submit_pop   one push (or arrival-ring submit) and one pop at a steady queue size
+//   alloc   pool | malloc           size allocations followed by size frees, per op
+//   level   triage                  pq_level_of over a batch of size patients, per patient
+//   logger  sync | async            one logger_log_event to /dev/null
+#define MB_MAX_THREADS 64
+#define MB_MAX_LIST 16
+#define MB_CHUNK 256 // Operations between looks at the stop flag
+
+typedef struct {
+    const char* bench;
+    const char* variant;
+    long size;
+    void (*setup)(long size);
+    unsigned long (*run)(int thread, long size); // MB_CHUNK units of work; returns operations done
+    void (*teardown)(void);
+} MicroCase;
+
+typedef struct {
+    char key[96];
+    double ns_per_op;
+} MicroBaseline;
+
+static struct {
+    atomic_int stop;
+    pthread_barrier_t start;
+    const MicroCase* cs;
+    atomic_ulong ops;
+    PriorityQueue pq;
+    Patient* patients;      // Queue prefill and per-thread patients in hand
+    Patient* in_hand[MB_MAX_THREADS];
+    MicroBaseline* baseline;
+    int nbaseline;
+    double tolerance_pct;
+    int regressions;
+    volatile int sink;
+} mb;
+
+static uint64_t mb_rand(uint64_t* s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+static void mb_fill_patients(Patient* ps, long n, uint64_t seed) {
+    for (long i = 0; i < n; ++i) {
+        memset(&ps[i], 0, sizeof(Patient));
+        ps[i].id = (int)i + 1;
+        ps[i].type = (PatientType)(mb_rand(&seed) % PATIENT_TYPE_COUNT);
+        ps[i].severity = (int)(mb_rand(&seed) % 10) + 1;
     }
-    Patient* top = pq->patients[0];
-    for (int i = 1; i < pq->size; ++i) {
-        pq->patients[i-1] = pq->patients[i];
+}
+
+// Queue: size patients queued before timing, plus one in hand per thread
+static void mb_pq_setup(long size) {
+    mb.patients = malloc(sizeof(Patient) * (size_t)(size + MB_MAX_THREADS));
+    if (!mb.patients) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
     }
-    
-    pq->size--;
-    pthread_mutex_unlock(&pq->lock);
-    return top;
+    mb_fill_patients(mb.patients, size + MB_MAX_THREADS, 42);
+    pq_init(&mb.pq);
+    pq_set_aging(&mb.pq, 0, 0);
+    for (long i = 0; i < size; ++i)
+        pq_push(&mb.pq, &mb.patients[i]);
+    for (int t = 0; t < MB_MAX_THREADS; ++t)
+        mb.in_hand[t] = &mb.patients[size + t];
 }
 
-int pq_is_empty(PriorityQueue* pq) {
-    pthread_mutex_lock(&pq->lock);
-    int empty = (pq->size == 0);
-    pthread_mutex_unlock(&pq->lock);
-    return empty;
+static void mb_pq_teardown(void) {
+    pq_destroy(&mb.pq);
+    free(mb.patients);
+    mb.patients = NULL;
 }
-// ------------- LOGGER -------------
-static FILE* log_file = NULL;
-static pthread_mutex_t log_lock;
 
-void logger_init(const char* filename) {
-    pthread_mutex_init(&log_lock, NULL);
-    log_file = fopen(filename, "a");
+static unsigned long mb_pq_push_pop(int thread, long size) {
+    (void)size;
+    Patient* p = mb.in_hand[thread];
+    for (int i = 0; i < MB_CHUNK; ++i) {
+        if (p)
+            pq_push(&mb.pq, p);
+        p = pq_pop(&mb.pq);
+    }
+    mb.in_hand[thread] = p;
+    return MB_CHUNK;
 }
 
-void logger_log_event(const char* event, Patient* patient) {
-    pthread_mutex_lock(&log_lock);
-    if (log_file && patient) {
-        fprintf(log_file, "%s: PatientID=%d, Name=%s, Type=%d, Time=%ld\n", event, patient->id, patient->name, patient->type, patient->check_in_time);
-        fflush(log_file);
-    } else if (log_file) {
-        fprintf(log_file, "%s: (no patient)\n", event);
-        fflush(log_file);
+static unsigned long mb_pq_submit_pop(int thread, long size) {
+    (void)size;
+    Patient* p = mb.in_hand[thread];
+    for (int i = 0; i < MB_CHUNK; ++i) {
+        // A pop can miss the ring entries behind another thread's unfinished
+        // submit; the hand is then empty until a later pop finds one
+        if (p)
+            pq_submit(&mb.pq, p);
+        p = pq_pop(&mb.pq);
     }
-    pthread_mutex_unlock(&log_lock);
+    mb.in_hand[thread] = p;
+    return MB_CHUNK;
 }
 
-void logger_log_bed_status(int total_beds, int occupied_beds) {
-    pthread_mutex_lock(&log_lock);
-    if (log_file) {
-        fprintf(log_file, "Bed Status: %d/%d beds occupied\n", occupied_beds, total_beds);
-        fflush(log_file);
+static void mb_alloc_setup(long size) {
+    // Warm the pool so the timed loop only recycles
+    Patient* held[64];
+    for (int t = 0; t < MB_MAX_THREADS; ++t) {
+        for (long i = 0; i < size; ++i)
+            held[i] = patient_alloc();
+        for (long i = 0; i < size; ++i)
+            patient_free(held[i]);
     }
-    pthread_mutex_unlock(&log_lock);
 }
 
-void logger_close() {
-    pthread_mutex_lock(&log_lock);
-    if (log_file) {
-        fclose(log_file);
-        log_file = NULL;
+static unsigned long mb_alloc_pool(int thread, long size) {
+    (void)thread;
+    Patient* held[64];
+    for (int i = 0; i < MB_CHUNK / size; ++i) {
+        for (long j = 0; j < size; ++j)
+            held[j] = patient_alloc();
+        for (long j = 0; j < size; ++j)
+            patient_free(held[j]);
     }
-    pthread_mutex_unlock(&log_lock);
+    return (unsigned long)(MB_CHUNK / size);
+}
+
+static unsigned long mb_alloc_malloc(int thread, long size) {
+    (void)thread;
+    Patient* held[64];
+    for (int i = 0; i < MB_CHUNK / size; ++i) {
+        for (long j = 0; j < size; ++j) {
+            held[j] = malloc(sizeof(Patient));
+            memset(held[j], 0, sizeof(Patient));
+        }
+        for (long j = 0; j < size; ++j)
+            free(held[j]);
+    }
+    return (unsigned long)(MB_CHUNK / size);
 }
-// ------------- GLOBALS ------------
-static int occupied_beds = 0;
-static pthread_mutex_t bed_lock;
-PriorityQueue pq;
 
-// Semaphores for ICU/General beds
-sem_t icuBeds, generalBeds;
+static void mb_level_setup(long size) {
+    mb.patients = malloc(sizeof(Patient) * (size_t)size);
+    if (!mb.patients) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    mb_fill_patients(mb.patients, size, 7);
+}
 
-// For graceful shutdown
-volatile sig_atomic_t running = 1;
+static void mb_level_teardown(void) {
+    free(mb.patients);
+    mb.patients = NULL;
+}
 
-// Utility: Print real-time status
-void print_status() {
-    pthread_mutex_lock(&bed_lock);
-    printf(COLOR_BOLD COLOR_CYAN "\n[STATUS] Beds Occupied: %d/%d\n" COLOR_RESET, occupied_beds, TOTAL_BEDS);
-    printf(COLOR_BOLD COLOR_YELLOW "Patients in Queue: %d\n" COLOR_RESET, pq.size);
-    pthread_mutex_unlock(&bed_lock);
+static unsigned long mb_level(int thread, long size) {
+    (void)thread;
+    int acc = 0;
+    for (long i = 0; i < size; ++i)
+        acc += pq_level_of(&mb.patients[i]);
+    mb.sink = acc; // Keeps the loop from being optimised away
+    return (unsigned long)size;
 }
-// Signal handler for graceful shutdown
-void handle_sigint(int sig) {
-    running = 0;
-    printf(COLOR_BOLD COLOR_MAGENTA "\n[INFO] Shutting down hospital system...\n" COLOR_RESET);
+
+static void mb_logger_setup_mode(int async) {
+    LoggerConfig cfg = LOGGER_DEFAULT_CONFIG;
+    cfg.async = async;
+    logger_init_config("/dev/null", &cfg);
+    mb.patients = calloc(1, sizeof(Patient));
+    mb.patients->id = 1;
 }
 
-// Thread to periodically print status
-void* status_monitor(void* arg) {
-    while (running) {
-        print_status();
-        sleep(4);
-    }
+static void mb_logger_setup_sync(long size) {
+    (void)size;
+    mb_logger_setup_mode(0);
+}
+
+static void mb_logger_setup_async(long size) {
+    (void)size;
+    mb_logger_setup_mode(1);
+}
+
+static void mb_logger_teardown(void) {
+    logger_close();
+    pthread_mutex_destroy(&log_lock);
+    free(mb.patients);
+    mb.patients = NULL;
+}
+
+static unsigned long mb_logger(int thread, long size) {
+    (void)thread;
+    (void)size;
+    for (int i = 0; i < MB_CHUNK; ++i)
+        logger_log_event(LOG_EV_CHECKIN, mb.patients, WARD_COUNT, -1);
+    return MB_CHUNK;
+}
+
+static void* mb_worker(void* arg) {
+    int thread = (int)(intptr_t)arg;
+    const MicroCase* cs = mb.cs;
+    unsigned long ops = 0;
+    pthread_barrier_wait(&mb.start);
+    while (!atomic_load_explicit(&mb.stop, memory_order_relaxed))
+        ops += cs->run(thread, cs->size);
+    atomic_fetch_add(&mb.ops, ops);
     return NULL;
 }
-// ------------- THREAD ROUTINES -------------
-void* admit_patients(void* arg) {
-    while (1) {
-        pthread_mutex_lock(&bed_lock);
-        if (!pq_is_empty(&pq) && occupied_beds < TOTAL_BEDS) {
-            Patient* p = pq_pop(&pq);
-            occupied_beds++;
-            logger_log_event("Admitted", p);
-            logger_log_bed_status(TOTAL_BEDS, occupied_beds);
-            printf("Admitted: %s (%s)\n", p->name, (p->type==EMERGENCY)?"EMERGENCY":"REGULAR");
-            free(p);
-        }
-        pthread_mutex_unlock(&bed_lock);
-        sleep(1); // Simulate time between admissions
+
+static void mb_check_baseline(const char* key, double ns_per_op) {
+    for (int i = 0; i < mb.nbaseline; ++i) {
+        if (strcmp(mb.baseline[i].key, key) != 0)
+            continue;
+        double base = mb.baseline[i].ns_per_op;
+        if (base > 0 && ns_per_op > base * (1.0 + mb.tolerance_pct / 100.0)) {
+            fprintf(stderr, "[REGRESSION] %s: %.2f ns/op vs %.2f baseline (+%.1f%%)\n", key, ns_per_op, base,
+                    100.0 * (ns_per_op / base - 1.0));
+            mb.regressions++;
+        }
+        return;
     }
-    return NULL;
 }
 
-void* discharge_patients(void* arg) {
-    while (running) {
-        pthread_mutex_lock(&bed_lock);
-        if (occupied_beds > 0) {
-            occupied_beds--;
-            logger_log_event("Discharged", NULL);
-            logger_log_bed_status(TOTAL_BEDS, occupied_beds);
-            printf(COLOR_YELLOW "[DISCHARGE] Discharged a patient.\n" COLOR_RESET);
+static void mb_run_case(const MicroCase* cs, int threads, int ms, FILE* out) {
+    pthread_t tids[MB_MAX_THREADS];
+    if (cs->setup)
+        cs->setup(cs->size);
+    mb.cs = cs;
+    atomic_store(&mb.stop, 0);
+    atomic_store(&mb.ops, 0);
+    pthread_barrier_init(&mb.start, NULL, (unsigned)threads + 1);
+    for (int t = 0; t < threads; ++t)
+        pthread_create(&tids[t], NULL, mb_worker, (void*)(intptr_t)t);
+    pthread_barrier_wait(&mb.start);
+    uint64_t t0 = now_ns();
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+    atomic_store(&mb.stop, 1);
+    for (int t = 0; t < threads; ++t)
+        pthread_join(tids[t], NULL);
+    uint64_t elapsed = now_ns() - t0;
+    pthread_barrier_destroy(&mb.start);
+    if (cs->teardown)
+        cs->teardown();
+    unsigned long ops = atomic_load(&mb.ops);
+    double ns_per_op = ops ? (double)elapsed / (double)ops : 0.0;
+    char key[96];
+    snprintf(key, sizeof(key), "%s,%s,%ld,%d", cs->bench, cs->variant, cs->size, threads);
+    fprintf(out, "%s,%lu,%.6f,%.2f\n", key, ops, (double)elapsed / 1e9, ns_per_op);
+    fflush(out);
+    mb_check_baseline(key, ns_per_op);
+}
+
+// Rows of an earlier run's CSV, keyed on their first four columns
+static int mb_load_baseline(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "[ERROR] Cannot open baseline %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    char line[256];
+    int cap = 0;
+    while (fgets(line, sizeof(line), f)) {
+        char bench[32], variant[32];
+        long size;
+        int threads;
+        unsigned long ops;
+        double secs, ns;
+        if (sscanf(line, "%31[^,],%31[^,],%ld,%d,%lu,%lf,%lf", bench, variant, &size, &threads, &ops, &secs, &ns) != 7)
+            continue; // Header and comments
+        if (mb.nbaseline == cap) {
+            cap = cap ? cap * 2 : 64;
+            MicroBaseline* grown = realloc(mb.baseline, sizeof(MicroBaseline) * (size_t)cap);
+            if (!grown)
+                break;
+            mb.baseline = grown;
         }
-        pthread_mutex_unlock(&bed_lock);
-        sleep(5); // Simulate time between discharges
+        MicroBaseline* b = &mb.baseline[mb.nbaseline++];
+        snprintf(b->key, sizeof(b->key), "%s,%s,%ld,%d", bench, variant, size, threads);
+        b->ns_per_op = ns;
     }
-    return NULL;
+    fclose(f);
+    return 0;
 }
 
-void* allocate_bed(void* arg) {
-    Patient* p = (Patient*)arg;
-    if (p->type == ICU) {
-        printf(COLOR_CYAN "[ICU REQUEST] Patient %d requires ICU\n" COLOR_RESET, p->id);
-        sem_wait(&icuBeds);
-        printf(COLOR_BOLD COLOR_MAGENTA "[ICU ALLOCATED] Patient %d (Severity: %d)\n" COLOR_RESET, p->id, p->severity);
-        sleep(1);
-        sem_post(&icuBeds);
-    } else {
-        printf(COLOR_CYAN "[WARD REQUEST] Patient %d requires General Ward\n" COLOR_RESET, p->id);
-        sem_wait(&generalBeds);
-        printf(COLOR_BOLD COLOR_MAGENTA "[WARD ALLOCATED] Patient %d (Severity: %d)\n" COLOR_RESET, p->id, p->severity);
-        sleep(1);
-        sem_post(&generalBeds);
+static int mb_parse_longs(const char* s, long* out, long lo, long hi) {
+    int n = 0;
+    char* end;
+    while (*s && n < MB_MAX_LIST) {
+        long v = strtol(s, &end, 10);
+        if (end == s || v < lo || v > hi || (*end && *end != ','))
+            return -1;
+        out[n++] = v;
+        s = *end ? end + 1 : end;
+    }
+    return *s ? -1 : n;
+}
+
+// Edge values the cases never reach: each must land inside buckets[] and
+// leave the stored extremes intact. Returns the number of failures.
+static int mb_check_hist(void) {
+    static const uint64_t values[] = { 0, HIST_SUB - 1, HIST_SUB, (1ull << HIST_MAX_EXP) - 1, 1ull << HIST_MAX_EXP,
+                                       (1ull << (HIST_MAX_EXP + 1)) - 1, 1ull << 63, UINT64_MAX };
+    struct {
+        HistSnapshot s;
+        uint64_t guard;
+    } h = { .guard = 0x5a5a5a5a5a5a5a5aull };
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+        int b = hist_bucket(values[i]);
+        if (b < 0 || b >= HIST_BUCKETS) {
+            fprintf(stderr, "[ERROR] hist_bucket(%llu) = %d, outside 0..%d\n", (unsigned long long)values[i], b,
+                    HIST_BUCKETS - 1);
+            failed++;
+            continue;
+        }
+        hist_add(&h.s, values[i]);
+    }
+    uint64_t counted = 0;
+    for (int b = 0; b < HIST_BUCKETS; ++b)
+        counted += h.s.buckets[b];
+    if (h.guard != 0x5a5a5a5a5a5a5a5aull || counted != h.s.count || h.s.max != UINT64_MAX) {
+        fprintf(stderr, "[ERROR] Histogram overflowed its buckets\n");
+        failed++;
+    }
+    return failed;
+}
+
+static int mb_selected(const char* only, const char* bench) {
+    if (!only)
+        return 1;
+    size_t len = strlen(bench);
+    for (const char* s = only; (s = strstr(s, bench)); s += len)
+        if ((s == only || s[-1] == ',') && (s[len] == ',' || s[len] == '\0'))
+            return 1;
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    long sizes[MB_MAX_LIST] = { 10, 100, 1000, 10000, 100000, 1000000 };
+    long thread_list[MB_MAX_LIST] = { 1, 2, 4, 8, 16, 32, 64 };
+    int nsizes = 6, nthreads = 7, ms = 100;
+    const char* only = NULL;
+    const char* out_path = NULL;
+    const char* baseline_path = NULL;
+    mb.tolerance_pct = 10.0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--sizes") == 0 && i + 1 < argc) {
+            nsizes = mb_parse_longs(argv[++i], sizes, 1, 10000000);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            nthreads = mb_parse_longs(argv[++i], thread_list, 1, MB_MAX_THREADS);
+        } else if (strcmp(argv[i], "--ms") == 0 && i + 1 < argc) {
+            ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            only = argv[++i];
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (strcmp(argv[i], "--compare") == 0 && i + 1 < argc) {
+            baseline_path = argv[++i];
+        } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            mb.tolerance_pct = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (nsizes < 1 || nthreads < 1 || ms < 1) {
+        fprintf(stderr, "Invalid microbenchmark parameters\n");
+        return 1;
+    }
+    if (baseline_path && mb_load_baseline(baseline_path) < 0)
+        return 1;
+    if (mb_check_hist())
+        return 1;
+    FILE* out = out_path ? fopen(out_path, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "[ERROR] Cannot write %s: %s\n", out_path, strerror(errno));
+        return 1;
+    }
+    console_quiet = 1;
+    patient_pool_init(&patient_pool);
+    fprintf(out, "bench,variant,size,threads,ops,seconds,ns_per_op\n");
+
+    static const long alloc_sizes[] = { 1, 64 };
+    static const long level_sizes[] = { 1024 };
+    static const struct {
+        MicroCase proto;
+        const long* sizes; // NULL: the --sizes list
+        int nsizes;
+    } table[] = {
+        { { "pq", "push_pop", 0, mb_pq_setup, mb_pq_push_pop, mb_pq_teardown }, NULL, 0 },
+        { { "pq", "submit_pop", 0, mb_pq_setup, mb_pq_submit_pop, mb_pq_teardown }, NULL, 0 },
+        { { "alloc", "pool", 0, mb_alloc_setup, mb_alloc_pool, NULL }, alloc_sizes, 2 },
+        { { "alloc", "malloc", 0, NULL, mb_alloc_malloc, NULL }, alloc_sizes, 2 },
+        { { "level", "triage", 0, mb_level_setup, mb_level, mb_level_teardown }, level_sizes, 1 },
+        { { "logger", "sync", 0, mb_logger_setup_sync, mb_logger, mb_logger_teardown }, NULL, -1 },
+        { { "logger", "async", 0, mb_logger_setup_async, mb_logger, mb_logger_teardown }, NULL, -1 },
+    };
+    for (size_t c = 0; c < sizeof(table) / sizeof(table[0]); ++c) {
+        if (!mb_selected(only, table[c].proto.bench))
+            continue;
+        int n = table[c].sizes ? table[c].nsizes : table[c].nsizes < 0 ? 1 : nsizes;
+        for (int s = 0; s < n; ++s) {
+            MicroCase cs = table[c].proto;
+            cs.size = table[c].sizes ? table[c].sizes[s] : table[c].nsizes < 0 ? 0 : sizes[s];
+            for (int t = 0; t < nthreads; ++t)
+                mb_run_case(&cs, (int)thread_list[t], ms, out);
+        }
+    }
+    if (out != stdout)
+        fclose(out);
+    patient_pool_destroy(&patient_pool);
+    free(mb.baseline);
+    if (mb.regressions) {
+        fprintf(stderr, "[REGRESSION] %d cases slower than the baseline by more than %.1f%%\n", mb.regressions,
+                mb.tolerance_pct);
+        return 2;
+    }
+    return 0;
+}
+#elif defined(HOSPITAL_BENCH)
+// ------------- BENCHMARK -------------
+// Built with -DHOSPITAL_BENCH: drives synthetic arrivals through add_patient
+// and the real admission thread, then reports check-in -> admission latency
+// percentiles, admission throughput and lock wait time.
+typedef struct {
+    double rate;          // Total arrivals per second
+    int producers;
+    int duration_s;
+    int stay_ms;          // Bed hold after admission; 0 discharges immediately
+    int mix[4];           // Weights for REGULAR, EMERGENCY, GENERAL, ICU
+    uint64_t seed;
+    uint64_t* latencies;
+    size_t latency_cap;
+    atomic_size_t latency_count;
+    atomic_ulong arrivals;
+} BenchState;
+
+static BenchState bench;
+
+typedef struct {
+    Task task;
+    int patient_id;
+} BenchDischarge;
+
+static uint64_t bench_rand(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+static void bench_discharge(Task* t) {
+    BenchDischarge* d = (BenchDischarge*)t;
+    discharge_patient_id(d->patient_id); // Also refills the bed from the queue
+    free(d);
+}
+
+static void bench_on_admit(Hospital* h, Patient* p, int bed) {
+    size_t i = atomic_fetch_add_explicit(&bench.latency_count, 1, memory_order_relaxed);
+    if (i < bench.latency_cap)
+        bench.latencies[i] = now_ns() - p->check_in_ns;
+    BenchDischarge* d = (bench.stay_ms > 0) ? malloc(sizeof(BenchDischarge)) : NULL;
+    if (!d) {
+        // bed_lock is already held and the admission loop refills the bed
+        OccupantEntry e;
+        if (occ_remove_at(&h->occupants, p->id, WARD_ADMISSION, bed, &e) == 0) {
+            ward_release(&h->wards[WARD_ADMISSION], bed);
+            patient_free(e.patient);
+        }
+        return;
+    }
+    d->task.fn = bench_discharge;
+    d->patient_id = p->id;
+    pool_submit_after(&h->pool, &d->task, bench.stay_ms);
+}
+
+static void* bench_producer(void* arg) {
+    int idx = (int)(intptr_t)arg;
+    uint64_t rng = bench.seed + 0x9E3779B97F4A7C15ull * (uint64_t)(idx + 1);
+    double per_thread = bench.rate / bench.producers;
+    uint64_t interval = (uint64_t)(1e9 / (per_thread > 0 ? per_thread : 1));
+    uint64_t start = now_ns(), end = start + (uint64_t)bench.duration_s * 1000000000ull;
+    int total_weight = bench.mix[0] + bench.mix[1] + bench.mix[2] + bench.mix[3];
+    char name[32];
+    for (uint64_t k = 0;; ++k) {
+        uint64_t due = start + k * interval;
+        if (due >= end)
+            break;
+        uint64_t now = now_ns();
+        if (now < due) {
+            struct timespec ts = { (time_t)(due / 1000000000ull), (long)(due % 1000000000ull) };
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+        }
+        int pick = (int)(bench_rand(&rng) % (uint64_t)total_weight);
+        PatientType type = REGULAR;
+        while (type < ICU && pick >= bench.mix[type]) {
+            pick -= bench.mix[type];
+            type++;
+        }
+        int severity = (int)(bench_rand(&rng) % 10) + 1;
+        snprintf(name, sizeof(name), "Bench_%d_%lu", idx, (unsigned long)k);
+        add_patient(&hospitals[idx % hospital_count], name, type, severity, type == ICU);
+        atomic_fetch_add_explicit(&bench.arrivals, 1, memory_order_relaxed);
     }
-    free(p);
     return NULL;
 }
 
-// ------------- PATIENT ARRIVAL SIMULATION -------------
-void add_patient(const char* name, PatientType type, int severity, int isICU) {
-    Patient* p = malloc(sizeof(Patient));
-    static int id_gen = 1;
-    p->id = id_gen++;
-    strncpy(p->name, name, sizeof(p->name)-1);
-    p->name[sizeof(p->name)-1] = '\0';
-    p->type = type;
-    p->check_in_time = time(NULL);
-    p->severity = severity;
-    p->isICU = isICU;
-    pq_push(&pq, p);
-    logger_log_event("Check-In", p);
+static int bench_queued(void) {
+    int queued = 0;
+    for (int i = 0; i < hospital_count; i++)
+        queued += pq_size(&hospitals[i].pq);
+    return queued;
+}
+
+// Lock totals across shards, for the report
+static void bench_sum_lock(LockStats* sum, LockStats* st) {
+    atomic_fetch_add(&sum->acquisitions, atomic_load(&st->acquisitions));
+    atomic_fetch_add(&sum->contended, atomic_load(&st->contended));
+    atomic_fetch_add(&sum->wait_ns, atomic_load(&st->wait_ns));
+}
+
+static int bench_cmp_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static double bench_percentile(const uint64_t* sorted, size_t n, double pct) {
+    if (n == 0)
+        return 0.0;
+    size_t i = (size_t)(pct / 100.0 * (double)(n - 1) + 0.5);
+    return (double)sorted[i] / 1000.0;
+}
+
+static void bench_report_lock(const char* name, LockStats* st) {
+    unsigned long acq = atomic_load(&st->acquisitions), con = atomic_load(&st->contended);
+    double wait_ms = (double)atomic_load(&st->wait_ns) / 1e6;
+    printf("  %-8s acquisitions=%-9lu contended=%-8lu (%5.2f%%) wait_total=%.3f ms avg_wait=%.2f us\n",
+           name, acq, con, acq ? 100.0 * (double)con / (double)acq : 0.0, wait_ms,
+           con ? wait_ms * 1000.0 / (double)con : 0.0);
 }
 
+int main(int argc, char** argv) {
+    LoggerConfig log_config = LOGGER_DEFAULT_CONFIG;
+    log_config.async = 1;
+    const char* log_path = "/dev/null";
+    const char* journal_path = NULL;
+    const char* events_dir = NULL;
+    int beds = 64;
+    bench.rate = 20000;
+    bench.producers = 2;
+    bench.duration_s = 5;
+    bench.stay_ms = 0;
+    bench.mix[REGULAR] = 70;
+    bench.mix[EMERGENCY] = 20;
+    bench.mix[GENERAL] = 5;
+    bench.mix[ICU] = 5;
+    bench.seed = 42;
+    console_quiet = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            bench.rate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--producers") == 0 && i + 1 < argc) {
+            bench.producers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+            bench.duration_s = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--beds") == 0 && i + 1 < argc) {
+            beds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--stay-ms") == 0 && i + 1 < argc) {
+            bench.stay_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--mix") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d,%d,%d,%d", &bench.mix[REGULAR], &bench.mix[EMERGENCY],
+                       &bench.mix[GENERAL], &bench.mix[ICU]) != 4) {
+                fprintf(stderr, "--mix expects REGULAR,EMERGENCY,GENERAL,ICU weights\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            bench.seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--log") == 0 && i + 1 < argc) {
+            log_path = argv[++i];
+        } else if (strcmp(argv[i], "--log-sync") == 0) {
+            log_config.async = 0;
+        } else if (strcmp(argv[i], "--journal") == 0 && i + 1 < argc) {
+            journal_path = argv[++i];
+        } else if (strcmp(argv[i], "--events") == 0 && i + 1 < argc) {
+            events_dir = argv[++i];
+        } else if (strcmp(argv[i], "--metrics") == 0) {
+            metrics_enabled = 1;
+        } else if (strcmp(argv[i], "--console") == 0) {
+            console_quiet = 0;
+        } else if (strcmp(argv[i], "--hospitals") == 0 && i + 1 < argc) {
+            hospital_count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--cpus") == 0 && i + 1 < argc) {
+            if (affinity_configure(argv[++i]) < 0)
+                return 1;
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (bench.producers < 1 || bench.rate <= 0 || bench.duration_s < 1 || beds < 1
+        || hospital_count < 1 || hospital_count > MAX_HOSPITALS
+        || bench.mix[0] + bench.mix[1] + bench.mix[2] + bench.mix[3] <= 0) {
+        fprintf(stderr, "Invalid benchmark parameters\n");
+        return 1;
+    }
+    if (bench.seed == 0)
+        bench.seed = 1;
+    bench.latency_cap = (size_t)(bench.rate * bench.duration_s * 1.2) + 1024;
+    bench.latencies = malloc(sizeof(uint64_t) * bench.latency_cap);
+    if (!bench.latencies) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    patient_pool_init(&patient_pool);
+    if (events_dir && events_open(events_dir) < 0)
+        return 1;
+    logger_init_config(log_path, &log_config);
+    ward_stay_ms[WARD_ADMISSION] = 0; // --stay-ms drives admission-ward discharges here
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int i = 0; i < hospital_count; ++i) {
+        Hospital* h = &hospitals[i];
+        hospital_init_local(h, i, beds, journal_path, (hospital_count > 1 && ncpu > 0) ? i % (int)ncpu : -1);
+        pool_init(&h->pool, hospital_count > 1 ? SHARD_POOL_WORKERS : POOL_WORKERS);
+        for (int t = 0; t < h->pool.nthreads; ++t)
+            hospital_pin_thread(h, ROLE_WORKERS, h->pool.threads[t]);
+        status_publish(h);
+    }
+    admit_hook = bench_on_admit;
+
+    // Console output is skipped unless --console, which buffers it to /dev/null
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int devnull = open("/dev/null", O_WRONLY);
+    if (devnull >= 0) {
+        dup2(devnull, STDOUT_FILENO);
+        close(devnull);
+    }
+    console_init();
+
+    pthread_t* producers = malloc(sizeof(pthread_t) * bench.producers);
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < hospital_count; i++) {
+        pthread_create(&hospitals[i].admit_thread, NULL, admit_patients, &hospitals[i]);
+        pthread_create(&hospitals[i].discharge_thread, NULL, discharge_patients, &hospitals[i]);
+        hospital_pin_thread(&hospitals[i], ROLE_ADMIT, hospitals[i].admit_thread);
+        hospital_pin_thread(&hospitals[i], ROLE_DISCHARGE, hospitals[i].discharge_thread);
+    }
+    for (int i = 0; i < bench.producers; i++)
+        pthread_create(&producers[i], NULL, bench_producer, (void*)(intptr_t)i);
+    for (int i = 0; i < bench.producers; i++)
+        pthread_join(producers[i], NULL);
+    uint64_t arrivals_done = now_ns();
+    // Let the backlog drain, bounded so an undersized ward cannot hang the run
+    while (bench_queued() > 0 && now_ns() - arrivals_done < 10000000000ull)
+        usleep(1000);
+    uint64_t t1 = now_ns();
+    running = 0;
+    for (int i = 0; i < hospital_count; i++) {
+        Hospital* h = &hospitals[i];
+        pthread_mutex_lock(&h->bed_lock);
+        pthread_cond_broadcast(&h->admit_cond);
+        pthread_mutex_unlock(&h->bed_lock);
+        pthread_join(h->admit_thread, NULL);
+        pthread_join(h->discharge_thread, NULL);
+        pool_shutdown(&h->pool);
+    }
+    console_close();
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+
+    size_t n = atomic_load(&bench.latency_count);
+    if (n > bench.latency_cap)
+        n = bench.latency_cap;
+    qsort(bench.latencies, n, sizeof(uint64_t), bench_cmp_u64);
+    double elapsed = (double)(t1 - t0) / 1e9;
+    printf("Admission pipeline benchmark\n");
+    printf("  rate=%.0f/s producers=%d hospitals=%d duration=%ds beds=%d stay=%dms mix=%d,%d,%d,%d\n",
+           bench.rate, bench.producers, hospital_count, bench.duration_s, beds, bench.stay_ms,
+           bench.mix[REGULAR], bench.mix[EMERGENCY], bench.mix[GENERAL], bench.mix[ICU]);
+    printf("  arrivals=%lu admitted=%zu left_in_queue=%d elapsed=%.3fs\n",
+           atomic_load(&bench.arrivals), n, bench_queued(), elapsed);
+    printf("  throughput=%.0f admissions/s\n", elapsed > 0 ? (double)n / elapsed : 0.0);
+    printf("  latency_us p50=%.1f p99=%.1f p999=%.1f max=%.1f\n",
+           bench_percentile(bench.latencies, n, 50.0), bench_percentile(bench.latencies, n, 99.0),
+           bench_percentile(bench.latencies, n, 99.9), n ? (double)bench.latencies[n - 1] / 1000.0 : 0.0);
+    printf("Lock wait\n");
+    LockStats push = {0}, pop = {0}, bed = {0};
+    for (int i = 0; i < hospital_count; i++) {
+        bench_sum_lock(&push, &hospitals[i].pq.push_stats);
+        bench_sum_lock(&pop, &hospitals[i].pq.pop_stats);
+        bench_sum_lock(&bed, &hospitals[i].bed_lock_stats);
+    }
+    bench_report_lock("pq_push", &push);
+    bench_report_lock("pq_pop", &pop);
+    bench_report_lock("bed_lock", &bed);
+    if (metrics_enabled)
+        metrics_write_prometheus(stdout);
+
+    free(producers);
+    free(bench.latencies);
+    for (int i = 0; i < hospital_count; i++)
+        journal_close(&hospitals[i].journal);
+    logger_close();
+    return 0;
+}
+#else
 // ------------- MAIN -------------
-int main() {
-    signal(SIGINT, handle_sigint);
-    pthread_mutex_init(&bed_lock, NULL);
-    pq_init(&pq);
-    logger_init("hospital.log");
-
-    // ICU/General beds
-    sem_init(&icuBeds, 0, ICU_BEDS);
-    sem_init(&generalBeds, 0, GENERAL_BEDS);
-
-    pthread_t admit_thread, discharge_thread, status_thread;
-    pthread_create(&admit_thread, NULL, admit_patients, NULL);
-    pthread_create(&discharge_thread, NULL, discharge_patients, NULL);
+// "lo-hi[:step]" or a single value
+static int plan_parse_range(const char* s, int* lo, int* hi, int* step) {
+    *step = 1;
+    int n = sscanf(s, "%d-%d:%d", lo, hi, step);
+    if (n == 1)
+        *hi = *lo;
+    return (n >= 1 && *lo >= 0 && *hi >= *lo && *step >= 1 && *hi <= WARD_MAX_BEDS) ? 0 : -1;
+}
+
+// --plan-beds A,I,G with each entry a range
+static int plan_parse_beds(PlanSpec* spec, const char* arg) {
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%s", arg);
+    char* rest = buf;
+    for (int i = 0; i < WARD_COUNT; ++i) {
+        char* tok = strsep(&rest, ",");
+        if (!tok || plan_parse_range(tok, &spec->bed_lo[i], &spec->bed_hi[i], &spec->bed_step[i]) < 0)
+            return -1;
+    }
+    return rest ? -1 : 0;
+}
+
+// Comma-separated positive numbers
+static int plan_parse_list(const char* arg, double* out, int* n) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", arg);
+    char* rest = buf;
+    char* tok;
+    *n = 0;
+    while ((tok = strsep(&rest, ",")) && *n < PLAN_MAX_VALUES) {
+        char* end;
+        out[*n] = strtod(tok, &end);
+        if (*end || out[*n] <= 0)
+            return -1;
+        (*n)++;
+    }
+    return (*n > 0 && !tok) ? 0 : -1;
+}
+
+// Slash-separated R,E,G,I weight sets
+static int plan_parse_mixes(PlanSpec* spec, const char* arg) {
+    char buf[512];
+    snprintf(buf, sizeof(buf), "%s", arg);
+    char* rest = buf;
+    char* tok;
+    spec->nmix = 0;
+    while ((tok = strsep(&rest, "/")) && spec->nmix < PLAN_MAX_VALUES) {
+        int* m = spec->mix[spec->nmix];
+        if (sscanf(tok, "%d,%d,%d,%d", &m[0], &m[1], &m[2], &m[3]) != 4 || m[0] + m[1] + m[2] + m[3] <= 0)
+            return -1;
+        spec->nmix++;
+    }
+    return (spec->nmix > 0 && !tok) ? 0 : -1;
+}
+
+// Axes left unset sweep a single point taken from base
+static void plan_spec_defaults(PlanSpec* spec, const SimConfig* base) {
+    spec->base = *base;
+    if (spec->bed_step[0] == 0)
+        for (int i = 0; i < WARD_COUNT; ++i) {
+            spec->bed_lo[i] = spec->bed_hi[i] = base->beds[i];
+            spec->bed_step[i] = 1;
+        }
+    if (spec->nstay == 0) {
+        spec->stay[0] = base->mean_stay_hours;
+        spec->nstay = 1;
+    }
+    if (spec->nward_stay == 0) {
+        spec->ward_stay[0] = base->mean_ward_stay_hours;
+        spec->nward_stay = 1;
+    }
+    if (spec->nmix == 0) {
+        memcpy(spec->mix[0], base->mix, sizeof(spec->mix[0]));
+        spec->nmix = 1;
+    }
+}
+
+// Skip the rest of an input line; stops at EOF or when a shutdown interrupts the read
+static void discard_line(void) {
+    int c;
+    while ((c = getchar()) != '\n' && c != EOF)
+        ;
+}
+
+// With several shards, ask which hospital an interactive check-in is for
+static Hospital* prompt_hospital(void) {
+    if (hospital_count == 1)
+        return &hospitals[0];
+    int index = 0;
+    printf("Hospital (0-%d): ", hospital_count - 1);
+    if (scanf("%d", &index) != 1 || !hospital_at(index))
+        index = 0;
+    discard_line();
+    return &hospitals[index];
+}
+
+int main(int argc, char** argv) {
+    LoggerConfig log_config = LOGGER_DEFAULT_CONFIG;
+    log_config.async = 1;
+    const char* journal_path = "hospital.journal";
+    int aging_secs = PQ_DEFAULT_AGING_SECS;
+    int aging_max_level = PQ_LEVEL(EMERGENCY, 1);
+    int simulate = 0;
+    int metrics = 1;
+    int pin = 1;
+    SimConfig sim_config = SIM_DEFAULT_CONFIG;
+    int sim_beds_set = 0;
+    int plan = 0;
+    PlanSpec plan_spec = { .runs = 100 };
+    plan_spec.threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    const char* load_path = NULL;
+    const char* events_dir = EVENTS_DEFAULT_DIR;
+    const char* audit_query = NULL;
+    const char* listen_addr = "0.0.0.0";
+    int listen_port = 0;
+    NetServer net_server = { .listen_fd = -1, .epoll_fd = -1, .wake_fd = -1, .census_fd = -1 };
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--simulate") == 0) {
+            simulate = 1;
+        } else if (strcmp(argv[i], "--sim-days") == 0 && i + 1 < argc) {
+            sim_config.days = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            sim_config.seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--sim-arrivals") == 0 && i + 1 < argc) {
+            sim_config.arrivals_per_hour = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--sim-stay-hours") == 0 && i + 1 < argc) {
+            sim_config.mean_stay_hours = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--sim-ward-arrivals") == 0 && i + 1 < argc) {
+            sim_config.ward_arrivals_per_hour = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--sim-ward-stay-hours") == 0 && i + 1 < argc) {
+            sim_config.mean_ward_stay_hours = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--sim-beds") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d,%d,%d", &sim_config.beds[WARD_ADMISSION],
+                       &sim_config.beds[WARD_ICU], &sim_config.beds[WARD_GENERAL]) != 3) {
+                fprintf(stderr, "--sim-beds expects ADMISSION,ICU,GENERAL\n");
+                return 1;
+            }
+            sim_beds_set = 1;
+        } else if (strcmp(argv[i], "--sim-mix") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d,%d,%d,%d", &sim_config.mix[REGULAR], &sim_config.mix[EMERGENCY],
+                       &sim_config.mix[GENERAL], &sim_config.mix[ICU]) != 4) {
+                fprintf(stderr, "--sim-mix expects REGULAR,EMERGENCY,GENERAL,ICU weights\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--log-sync") == 0) {
+            log_config.async = 0;
+        } else if (strcmp(argv[i], "--plan") == 0) {
+            plan = 1;
+        } else if (strcmp(argv[i], "--plan-beds") == 0 && i + 1 < argc) {
+            if (plan_parse_beds(&plan_spec, argv[++i]) < 0) {
+                fprintf(stderr, "--plan-beds expects ADMISSION,ICU,GENERAL ranges like 5,2-8,5-20:5\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--plan-stay-hours") == 0 && i + 1 < argc) {
+            if (plan_parse_list(argv[++i], plan_spec.stay, &plan_spec.nstay) < 0) {
+                fprintf(stderr, "--plan-stay-hours expects up to %d comma-separated hours\n", PLAN_MAX_VALUES);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--plan-ward-stay-hours") == 0 && i + 1 < argc) {
+            if (plan_parse_list(argv[++i], plan_spec.ward_stay, &plan_spec.nward_stay) < 0) {
+                fprintf(stderr, "--plan-ward-stay-hours expects up to %d comma-separated hours\n", PLAN_MAX_VALUES);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--plan-mix") == 0 && i + 1 < argc) {
+            if (plan_parse_mixes(&plan_spec, argv[++i]) < 0) {
+                fprintf(stderr, "--plan-mix expects R,E,G,I weight sets separated by '/'\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--plan-runs") == 0 && i + 1 < argc) {
+            plan_spec.runs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--plan-threads") == 0 && i + 1 < argc) {
+            plan_spec.threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--plan-target-p99") == 0 && i + 1 < argc) {
+            plan_spec.target_p99_min = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--log-fsync") == 0) {
+            log_config.durability = LOG_DURABILITY_FSYNC;
+        } else if (strcmp(argv[i], "--log-no-flush") == 0) {
+            log_config.durability = LOG_DURABILITY_NONE;
+        } else if (strcmp(argv[i], "--log-flush-ms") == 0 && i + 1 < argc) {
+            log_config.flush_interval_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--log-batch") == 0 && i + 1 < argc) {
+            log_config.batch_size = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--aging-secs") == 0 && i + 1 < argc) {
+            aging_secs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--aging-max-level") == 0 && i + 1 < argc) {
+            aging_max_level = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--journal") == 0 && i + 1 < argc) {
+            journal_path = argv[++i];
+        } else if (strcmp(argv[i], "--no-journal") == 0) {
+            journal_path = NULL;
+        } else if (strcmp(argv[i], "--load") == 0 && i + 1 < argc) {
+            load_path = argv[++i];
+        } else if (strcmp(argv[i], "--events") == 0 && i + 1 < argc) {
+            events_dir = argv[++i];
+        } else if (strcmp(argv[i], "--no-events") == 0) {
+            events_dir = NULL;
+        } else if (strcmp(argv[i], "--audit") == 0 && i + 1 < argc) {
+            audit_query = argv[++i];
+        } else if (strcmp(argv[i], "--listen") == 0 && i + 1 < argc) {
+            listen_port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bind") == 0 && i + 1 < argc) {
+            listen_addr = argv[++i];
+        } else if (strcmp(argv[i], "--metrics-file") == 0 && i + 1 < argc) {
+            metrics_file = argv[++i];
+        } else if (strcmp(argv[i], "--no-metrics") == 0) {
+            metrics = 0;
+        } else if (strcmp(argv[i], "--hospitals") == 0 && i + 1 < argc) {
+            hospital_count = atoi(argv[++i]);
+            if (hospital_count < 1 || hospital_count > MAX_HOSPITALS) {
+                fprintf(stderr, "--hospitals expects 1-%d\n", MAX_HOSPITALS);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--no-pin") == 0) {
+            pin = 0;
+        } else if (strcmp(argv[i], "--cpus") == 0 && i + 1 < argc) {
+            if (affinity_configure(argv[++i]) < 0)
+                return 1;
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            console_quiet = 1;
+        } else if (strcmp(argv[i], "--console-flush-ms") == 0 && i + 1 < argc) {
+            console_flush_ms = atoi(argv[++i]);
+            if (console_flush_ms < 1)
+                console_flush_ms = 1;
+        } else if (strcmp(argv[i], "--wards") == 0 && i + 1 < argc) {
+            if (ward_layout_load(argv[++i]) < 0)
+                return 1;
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (audit_query)
+        return events_audit(events_dir ? events_dir : EVENTS_DEFAULT_DIR, audit_query, stdout) < 0 ? 1 : 0;
+
+    if (plan) {
+        sim_config.aging_secs = aging_secs;
+        if (!sim_beds_set)
+            memcpy(sim_config.beds, ward_beds, sizeof(sim_config.beds));
+        plan_spec_defaults(&plan_spec, &sim_config);
+        return plan_run(&plan_spec) < 0 ? 1 : 0;
+    }
+
+    if (simulate) {
+        SimResult res;
+        sim_config.aging_secs = aging_secs;
+        if (!sim_beds_set)
+            memcpy(sim_config.beds, ward_beds, sizeof(sim_config.beds));
+        if (sim_run(&sim_config, &res) < 0) {
+            fprintf(stderr, "Invalid simulation parameters\n");
+            return 1;
+        }
+        sim_print_report(&sim_config, &res);
+        sim_result_free(&res);
+        return 0;
+    }
+
+    // The simulator runs without metrics; its queue would only skew the live numbers
+    metrics_enabled = metrics;
+    if (control_init() < 0)
+        return 1;
+    console_init();
+    patient_pool_init(&patient_pool);
+    if (events_dir)
+        events_open(events_dir); // On failure the log runs without the event store
+    logger_init_config("hospital.log", &log_config);
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int i = 0; i < hospital_count; ++i) {
+        Hospital* h = &hospitals[i];
+        int cpu = (pin && hospital_count > 1 && ncpu > 0) ? i % (int)ncpu : -1;
+        int max_id = hospital_init_local(h, i, ward_beds[WARD_ADMISSION], journal_path, cpu);
+        if (max_id >= atomic_load(&next_patient_id))
+            atomic_store(&next_patient_id, max_id + 1);
+        pq_set_aging(&h->pq, aging_secs, aging_max_level);
+    }
+    for (int i = 0; i < hospital_count; ++i)
+        hospital_start(&hospitals[i], hospital_count > 1 ? SHARD_POOL_WORKERS : POOL_WORKERS);
+
+    pthread_t status_thread;
     pthread_create(&status_thread, NULL, status_monitor, NULL);
+    affinity_pin_role(status_thread, ROLE_STATUS);
+
+    if (listen_port > 0 && net_server_start(&net_server, listen_addr, listen_port) == 0)
+        affinity_pin_role(net_server.thread, ROLE_NET);
+    if (load_path)
+        load_patients_file(&hospitals[0], load_path);
+
+    // Initial patients, one a second; a shutdown request cuts the demo short
+    static const struct { const char* name; PatientType type; int severity, isICU; } initial[] = {
+        { "Alice", REGULAR, 5, 0 }, { "Bob", EMERGENCY, 9, 1 }, { "Charlie", REGULAR, 3, 0 },
+        { "Diana", EMERGENCY, 10, 1 }, { "Eve", REGULAR, 2, 0 }, { "Frank", REGULAR, 4, 0 },
+    };
+    Hospital* home = &hospitals[0];
+    for (size_t i = 0; i < sizeof(initial) / sizeof(initial[0]) && running; ++i) {
+        if (i > 0 && control_wait_ms(1000))
+            break;
+        add_patient(home, initial[i].name, initial[i].type, initial[i].severity, initial[i].isICU);
+    }
 
-    // Initial patients
-    add_patient("Alice", REGULAR, 5, 0);
-    sleep(1);
-    add_patient("Bob", EMERGENCY, 9, 1);
-    sleep(1);
-    add_patient("Charlie", REGULAR, 3, 0);
-    sleep(1);
-    add_patient("Diana", EMERGENCY, 10, 1);
-    sleep(1);
-    add_patient("Eve", REGULAR, 2, 0);
-    sleep(1);
-    add_patient("Frank", REGULAR, 4, 0);
-
-    // Simulate ICU/General bed allocation
-    pthread_t threads[10];
-    for (int i = 0; i < 10; i++) {
-        Patient* p = malloc(sizeof(Patient));
+    // Simulate ICU/General bed allocation, spread over the shards
+    for (int i = 0; i < 10 && running; i++) {
+        Patient* p = patient_alloc();
+        if (!p) break;
         p->id = 100 + i;
-        snprintf(p->name, sizeof(p->name), "WardPatient_%d", p->id);
+        char name[32];
+        snprintf(name, sizeof(name), "WardPatient_%d", p->id);
+        p->ident = identity_intern(name, 0);
         p->severity = rand() % 10 + 1;
         p->type = (p->severity > 6) ? ICU : GENERAL;
-        pthread_create(&threads[i], NULL, allocate_bed, (void*)p);
-        usleep(100000); // 0.1 sec
-    }
-    for (int i = 0; i < 10; i++) {
-        pthread_join(threads[i], NULL);
+        if (allocate_bed(&hospitals[i % hospital_count], p) < 0)
+            patient_free(p);
+        control_wait_ms(100); // 0.1 sec
     }
+    for (int i = 0; i < hospital_count; ++i)
+        pool_wait_idle(&hospitals[i].pool);
 
     // --- Interactive User Input Loop ---
     char cmd[16];
+    int exit_requested = 0;
+    console_direct = 1;
     while (running) {
-        printf(COLOR_BOLD COLOR_CYAN "\nType 'add' to admit patient, 'emergency' for emergency, 'status' for status, or 'exit' to quit:\n> " COLOR_RESET);
+        console_flush();
+        printf(COLOR_BOLD COLOR_CYAN "\nType 'add' to admit patient, 'emergency' for emergency, 'load' to import a file, 'discharge' or 'transfer' by patient id, 'find' by name or MRN, 'audit' to query the event history, 'status' for status, 'metrics' for a Prometheus dump, or 'exit' to quit:\n> " COLOR_RESET);
         fflush(stdout);
         if (!fgets(cmd, sizeof(cmd), stdin)) break;
         if (strncmp(cmd, "add", 3) == 0) {
             char name[64]; int sev, icu;
+            Hospital* h = prompt_hospital();
             printf("Enter patient name: ");
-            fgets(name, sizeof(name), stdin);
+            if (!fgets(name, sizeof(name), stdin)) break;
             name[strcspn(name, "\n")] = 0;
             printf("Enter severity (1-10): ");
-            scanf("%d", &sev); while(getchar()!='\n');
+            if (scanf("%d", &sev) != 1) sev = 5;
+            discard_line();
             printf("ICU? (1 for yes, 0 for no): ");
-            scanf("%d", &icu); while(getchar()!='\n');
-            add_patient(name, icu ? ICU : REGULAR, sev, icu);
+            if (scanf("%d", &icu) != 1) icu = 0;
+            discard_line();
+            if (!running) break;
+            add_patient(h, name, icu ? ICU : REGULAR, sev, icu);
         } else if (strncmp(cmd, "emergency", 9) == 0) {
             char name[64];
+            Hospital* h = prompt_hospital();
             printf("Enter emergency patient name: ");
-            fgets(name, sizeof(name), stdin);
+            if (!fgets(name, sizeof(name), stdin)) break;
             name[strcspn(name, "\n")] = 0;
-            add_patient(name, EMERGENCY, 10, 1);
+            add_patient(h, name, EMERGENCY, 10, 1);
             printf(COLOR_RED "[EMERGENCY] Emergency patient added!\n" COLOR_RESET);
+        } else if (strncmp(cmd, "load", 4) == 0) {
+            char path[256];
+            Hospital* h = prompt_hospital();
+            printf("Enter intake file path: ");
+            if (!fgets(path, sizeof(path), stdin)) break;
+            path[strcspn(path, "\n")] = 0;
+            load_patients_file(h, path);
+        } else if (strncmp(cmd, "discharge", 9) == 0) {
+            int id;
+            printf("Enter patient id: ");
+            if (scanf("%d", &id) != 1) id = -1;
+            discard_line();
+            if (discharge_patient_id(id) < 0)
+                printf(COLOR_RED "[ERROR] Patient %d does not hold a bed.\n" COLOR_RESET, id);
+        } else if (strncmp(cmd, "transfer", 8) == 0) {
+            int id; char ward[16];
+            printf("Enter patient id: ");
+            if (scanf("%d", &id) != 1) id = -1;
+            discard_line();
+            printf("Target ward (icu/general/admission): ");
+            if (!fgets(ward, sizeof(ward), stdin)) break;
+            ward[strcspn(ward, "\n")] = 0;
+            WardId to = ward_parse(ward);
+            if (to == WARD_COUNT)
+                printf(COLOR_RED "[ERROR] Unknown ward '%s'.\n" COLOR_RESET, ward);
+            else if (transfer_patient(id, to) < 0)
+                printf(COLOR_RED "[ERROR] Could not transfer patient %d to %s.\n" COLOR_RESET, id, ward_names[to]);
+        } else if (strncmp(cmd, "find", 4) == 0) {
+            char key[IDENT_NAME_MAX];
+            printf("Patient name or #MRN: ");
+            if (!fgets(key, sizeof(key), stdin)) break;
+            key[strcspn(key, "\n")] = 0;
+            IdentityHandle who = identity_lookup(key);
+            char desc[256];
+            identity_describe(who, desc, sizeof(desc));
+            if (who)
+                printf(COLOR_CYAN "[FIND] %s\n" COLOR_RESET, desc);
+            else
+                printf(COLOR_RED "[ERROR] No patient '%s'.\n" COLOR_RESET, key);
+        } else if (strncmp(cmd, "audit", 5) == 0) {
+            char query[256];
+            printf("Audit query (patient=<id> mrn=<n> name=<name> event=<type> ward=<ward> since=<date|Nd> until=<date|Nd> limit=<n>): ");
+            if (!fgets(query, sizeof(query), stdin)) break;
+            query[strcspn(query, "\n")] = 0;
+            if (!events_dir)
+                printf(COLOR_RED "[ERROR] Event store disabled (--no-events).\n" COLOR_RESET);
+            else
+                events_audit(events_dir, query, stdout);
         } else if (strncmp(cmd, "status", 6) == 0) {
             print_status();
+            print_metrics_summary();
+        } else if (strncmp(cmd, "metrics", 7) == 0) {
+            metrics_write_prometheus(stdout);
         } else if (strncmp(cmd, "exit", 4) == 0) {
-            running = 0;
+            exit_requested = 1;
             break;
         }
     }
 
-    // Cleanup
-    running = 0;
-    pthread_join(admit_thread, NULL);
-    pthread_join(discharge_thread, NULL);
+    // Cleanup: stop intake first, then persist what is still queued
+    control_request_shutdown(exit_requested ? "exit" : "end of input");
+    net_server_stop(&net_server);
+    int queued = 0;
+    for (int i = 0; i < hospital_count; ++i) {
+        hospital_stop(&hospitals[i]);
+        queued += pq_size(&hospitals[i].pq);
+    }
     pthread_join(status_thread, NULL);
+    if (queued > 0)
+        console_printf(COLOR_YELLOW "[INFO] %d queued patients %s\n" COLOR_RESET, queued,
+                       journal_path ? "saved to the journal" : "dropped (no journal)");
+    console_close();
     logger_close();
-    printf(COLOR_BOLD COLOR_GREEN "System shutdown complete.\n" COLOR_RESET);
+    control_close();
+    for (int i = 0; i < hospital_count; ++i)
+        hospital_destroy(&hospitals[i]);
+    metrics_destroy();
+    patient_pool_destroy(&patient_pool);
+    identity_store_destroy();
+    printf(COLOR_BOLD COLOR_GREEN "System shutdown complete in %.1f ms.\n" COLOR_RESET, control_shutdown_ms());
     return 0;
 }
+#endif